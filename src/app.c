@@ -13,10 +13,14 @@ void app_create(rg_app *app,
                 int font_size,
                 int tiles_wide,
                 int tiles_high,
-                const char *menu_bg_texture_path)
+                const char *menu_bg_texture_path,
+                bool headless)
 {
-    memset(app, 0, sizeof(app));
+    memset(app, 0, sizeof(*app));
 
+    // The dummy video driver keeps the window surface in memory, nothing
+    // needs a display or a GPU.
+    if (headless) SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
     if (SDL_Init(SDL_INIT_VIDEO) != 0) panic("failed to initalize SDL");
 
     int img_flags = IMG_INIT_PNG;
@@ -24,6 +28,7 @@ void app_create(rg_app *app,
         panic("failed to initialize SDL_image");
 
     app->running = true;
+    app->headless = headless;
     app->screen_width = screen_width;
     app->screen_height = screen_height;
     app->window = SDL_CreateWindow("roguelike",
@@ -34,7 +39,9 @@ void app_create(rg_app *app,
                                    SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE);
     if (app->window == NULL) panic("failed to create window");
 
-    app->renderer = SDL_CreateRenderer(app->window, -1, 0);
+    const Uint32 renderer_flags =
+      headless ? SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE : 0;
+    app->renderer = SDL_CreateRenderer(app->window, -1, renderer_flags);
     if (app->renderer == NULL) panic("failed to create renderer");
     app->screen = APP_SCREEN_MENU;
 
@@ -52,7 +59,12 @@ void app_create(rg_app *app,
                     app->screen_height,
                     &app->tileset,
                     "roguelike",
-                    true);
+                    !headless);
+    frame_view_create(&app->game_view,
+                      app->renderer,
+                      &app->tileset,
+                      app->screen_width,
+                      app->screen_height);
     // Texture
     {
         SDL_Surface *s = IMG_Load(menu_bg_texture_path);
@@ -69,9 +81,28 @@ void app_destroy(rg_app *app)
 {
     if (app == NULL) return;
     SDL_DestroyTexture(app->main_menu_bg_texture);
+    frame_view_destroy(&app->game_view);
     tileset_destroy(&app->tileset);
     terminal_destroy(&app->terminal);
     SDL_DestroyRenderer(app->renderer);
     SDL_DestroyWindow(app->window);
     SDL_Quit();
-}
\ No newline at end of file
+}
+
+// Writes the last presented frame to a BMP file.
+bool app_snapshot(rg_app *app, const char *file)
+{
+    int w, h;
+    if (SDL_GetRendererOutputSize(app->renderer, &w, &h) != 0) return false;
+    SDL_Surface *s =
+      SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (s == NULL) return false;
+    bool ok = SDL_RenderReadPixels(app->renderer,
+                                   NULL,
+                                   SDL_PIXELFORMAT_ARGB8888,
+                                   s->pixels,
+                                   s->pitch) == 0 &&
+              SDL_SaveBMP(s, file) == 0;
+    SDL_FreeSurface(s);
+    return ok;
+}
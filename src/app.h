@@ -2,9 +2,11 @@
 #define APP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <SDL.h>
 
+#include "frame.h"
 #include "terminal.h"
 #include "tileset.h"
 #include "gameplay_state.h"
@@ -20,13 +22,18 @@ typedef struct rg_app
 {
     SDL_Window* window;
     SDL_Renderer* renderer;
+    bool headless; // software rendering into a window that is never shown
     bool running;
     int screen_width;
     int screen_height;
     rg_tileset tileset;
     rg_terminal terminal;
+    rg_frame_view game_view; // renders game frames, on the main thread
     app_screen screen;
     SDL_Texture* main_menu_bg_texture;
+    uint64_t seed; // for new games, 0 seeds from the clock
+    int map_width; // of new games, in cells
+    int map_height;
 
     rg_game_state_data game_state_data;
     rg_main_menu_state_data menu_state_data;
@@ -39,7 +46,9 @@ void app_create(rg_app* app,
                 int font_size,
                 int tiles_wide,
                 int tiles_high,
-                const char* menu_bg_texture_path);
+                const char* menu_bg_texture_path,
+                bool headless);
 void app_destroy(rg_app* app);
+bool app_snapshot(rg_app* app, const char* file);
 
 #endif
\ No newline at end of file
@@ -198,13 +198,14 @@ static astar_path* astar_path_new_intern(int w, int h)
     return path;
 }
 
-astar_path* astar_path_new_using_map(rg_fov_map* map, float diagonalCost)
+astar_path* astar_path_new_using_view(const rg_tile_view* view,
+                                      float diagonalCost)
 {
     astar_path* path;
-    if (map == NULL) return (astar_path*)NULL;
-    path = astar_path_new_intern(map->width, map->height);
+    if (view == NULL) return (astar_path*)NULL;
+    path = astar_path_new_intern(view->map->width, view->map->height);
     if (!path) return (astar_path*)NULL;
-    path->map = map;
+    path->view = *view;
     path->diagonalCost = diagonalCost;
     return path;
 }
@@ -419,8 +420,7 @@ static float astar_path_walk_cost(astar_path* path,
                                  int xTo,
                                  int yTo)
 {
-    // if (path->map)
-    return fov_map_is_walkable(path->map, xTo, yTo) ? 1.0f : 0.0f;
+    return tile_view_is_walkable(&path->view, xTo, yTo) ? 1.0f : 0.0f;
     // return path->func(xFrom, yFrom, xTo, yTo, path->user_data);
 }
 
@@ -3,7 +3,7 @@
 
 #include <stdbool.h>
 
-#include "fov.h"
+#include "game_map.h"
 
 enum
 {
@@ -42,10 +42,11 @@ typedef struct astar_path
     TCOD_list_t heap; /* min_heap used in the algorithm. stores the offset
                          in
                          grid/heuristic (offset=x+y*w) */
-    rg_fov_map* map;
+    rg_tile_view view;
 } astar_path;
 
-astar_path* astar_path_new_using_map(rg_fov_map* map, float diagonalCost);
+astar_path* astar_path_new_using_view(const rg_tile_view* view,
+                                      float diagonalCost);
 bool astar_path_compute(astar_path* p, int ox, int oy, int dx, int dy);
 bool astar_path_is_empty(astar_path* p);
 int astar_path_size(astar_path* p);
@@ -3,31 +3,57 @@
 
 #include <SDL.h>
 
-#define WHITE ((SDL_Color){ 255, 255, 255, 255 })
-#define BLACK ((SDL_Color){ 0, 0, 0, 255 })
-#define RED ((SDL_Color){ 255, 0, 0, 255 })
-#define GREEN ((SDL_Color){ 0, 255, 0, 255 })
-#define BLUE ((SDL_Color){ 0, 0, 255, 255 })
-#define YELLOW ((SDL_Color){ 255, 255, 0, 255 })
-#define ORANGE ((SDL_Color){ 255, 127, 0, 255 })
-#define VIOLET ((SDL_Color){ 127, 0, 255, 255 })
-#define CYAN ((SDL_Color){ 0, 255, 255, 255 })
-#define FLAME ((SDL_Color){ 255, 63, 0, 255 })
-#define SKY ((SDL_Color){ 0, 191, 255, 255 })
+// The _INIT forms are constant expressions, for static tables.
+#define WHITE_INIT { 255, 255, 255, 255 }
+#define WHITE ((SDL_Color)WHITE_INIT)
+#define BLACK_INIT { 0, 0, 0, 255 }
+#define BLACK ((SDL_Color)BLACK_INIT)
+#define RED_INIT { 255, 0, 0, 255 }
+#define RED ((SDL_Color)RED_INIT)
+#define GREEN_INIT { 0, 255, 0, 255 }
+#define GREEN ((SDL_Color)GREEN_INIT)
+#define BLUE_INIT { 0, 0, 255, 255 }
+#define BLUE ((SDL_Color)BLUE_INIT)
+#define YELLOW_INIT { 255, 255, 0, 255 }
+#define YELLOW ((SDL_Color)YELLOW_INIT)
+#define ORANGE_INIT { 255, 127, 0, 255 }
+#define ORANGE ((SDL_Color)ORANGE_INIT)
+#define VIOLET_INIT { 127, 0, 255, 255 }
+#define VIOLET ((SDL_Color)VIOLET_INIT)
+#define CYAN_INIT { 0, 255, 255, 255 }
+#define CYAN ((SDL_Color)CYAN_INIT)
+#define FLAME_INIT { 255, 63, 0, 255 }
+#define FLAME ((SDL_Color)FLAME_INIT)
+#define SKY_INIT { 0, 191, 255, 255 }
+#define SKY ((SDL_Color)SKY_INIT)
 
-#define DARK_WALL ((SDL_Color){ 0, 0, 100, 255 })
-#define DARK_GROUND ((SDL_Color){ 50, 50, 150, 255 })
-#define LIGHT_WALL ((SDL_Color){ 130, 110, 50, 255 })
-#define LIGHT_GROUND ((SDL_Color){ 200, 180, 50, 255 })
-#define DESATURATED_GREEN ((SDL_Color){ 63, 127, 63, 255 })
-#define DARKER_GREEN ((SDL_Color){ 0, 127, 0, 255 })
-#define DARKER_ORANGE ((SDL_Color){ 127, 63, 0, 255 })
-#define DARK_RED ((SDL_Color){ 191, 0, 0, 255 })
-#define LIGHT_RED ((SDL_Color){ 255, 63, 63, 255 })
-#define LIGHT_GREY ((SDL_Color){ 159, 159, 159, 255 })
-#define DARK_GREY ((SDL_Color){ 95, 95, 95, 255 })
-#define LIGHT_GREEN ((SDL_Color){ 63, 255, 63, 255 })
-#define LIGHT_PINK ((SDL_Color){ 255, 63, 159, 255 })
+#define DARK_WALL_INIT { 0, 0, 100, 255 }
+#define DARK_WALL ((SDL_Color)DARK_WALL_INIT)
+#define DARK_GROUND_INIT { 50, 50, 150, 255 }
+#define DARK_GROUND ((SDL_Color)DARK_GROUND_INIT)
+#define LIGHT_WALL_INIT { 130, 110, 50, 255 }
+#define LIGHT_WALL ((SDL_Color)LIGHT_WALL_INIT)
+#define LIGHT_GROUND_INIT { 200, 180, 50, 255 }
+#define LIGHT_GROUND ((SDL_Color)LIGHT_GROUND_INIT)
+#define DESATURATED_GREEN_INIT { 63, 127, 63, 255 }
+#define DESATURATED_GREEN ((SDL_Color)DESATURATED_GREEN_INIT)
+#define DARKER_GREEN_INIT { 0, 127, 0, 255 }
+#define DARKER_GREEN ((SDL_Color)DARKER_GREEN_INIT)
+#define DARKER_ORANGE_INIT { 127, 63, 0, 255 }
+#define DARKER_ORANGE ((SDL_Color)DARKER_ORANGE_INIT)
+#define DARK_RED_INIT { 191, 0, 0, 255 }
+#define DARK_RED ((SDL_Color)DARK_RED_INIT)
+#define LIGHT_RED_INIT { 255, 63, 63, 255 }
+#define LIGHT_RED ((SDL_Color)LIGHT_RED_INIT)
+#define LIGHT_GREY_INIT { 159, 159, 159, 255 }
+#define LIGHT_GREY ((SDL_Color)LIGHT_GREY_INIT)
+#define DARK_GREY_INIT { 95, 95, 95, 255 }
+#define DARK_GREY ((SDL_Color)DARK_GREY_INIT)
+#define LIGHT_GREEN_INIT { 63, 255, 63, 255 }
+#define LIGHT_GREEN ((SDL_Color)LIGHT_GREEN_INIT)
+#define LIGHT_PINK_INIT { 255, 63, 159, 255 }
+#define LIGHT_PINK ((SDL_Color)LIGHT_PINK_INIT)
 
-#define LIGHTEST_VIOLET ((SDL_Color){ 223, 191, 255, 255 })
+#define LIGHTEST_VIOLET_INIT { 223, 191, 255, 255 }
+#define LIGHTEST_VIOLET ((SDL_Color)LIGHTEST_VIOLET_INIT)
 #endif
\ No newline at end of file
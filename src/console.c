@@ -1,66 +1,156 @@
 #include "console.h"
 #include <string.h>
 
+#include "array.h"
 #include "color.h"
 #include "types.h"
 
+// Bumped when the renderer lost the contents of its render targets.
+static unsigned console_targets_epoch = 0;
+
 void console_create(rg_console *c,
                     SDL_Renderer *r,
                     int w,
                     int h,
                     rg_tileset *ts)
 {
-    memset(c, 0, sizeof(c));
+    memset(c, 0, sizeof(*c));
     c->renderer = r;
     c->width = w;
     c->height = h;
     c->tileset = ts;
-    SDL_DisplayMode mode;
-    SDL_GetCurrentDisplayMode(0, &mode);
 
-    int render_w = c->width * c->tileset->tile_size;
-    int render_h = c->height * c->tileset->tile_size;
-    c->texture = SDL_CreateTexture(
-      r, mode.format, SDL_TEXTUREACCESS_TARGET, render_w, render_h);
-    SDL_SetTextureBlendMode(c->texture, SDL_BLENDMODE_BLEND);
+    c->vertices.capacity = 4 * 64;
+    c->vertices.data = malloc(sizeof(*c->vertices.data) * c->vertices.capacity);
+    c->indices.capacity = 6 * 64;
+    c->indices.data = malloc(sizeof(*c->indices.data) * c->indices.capacity);
+    ASSERT_M(c->vertices.data != NULL && c->indices.data != NULL);
+
+    c->cells = malloc(sizeof(*c->cells) * w * h);
+    c->shown = malloc(sizeof(*c->shown) * w * h);
+    c->glyphs = malloc(sizeof(*c->glyphs) * w * h);
+    ASSERT_M(c->cells != NULL && c->shown != NULL && c->glyphs != NULL);
+    console_clear(c, BLACK);
 }
 
 void console_destroy(rg_console *c)
 {
     if (c == NULL) return;
-    if (c->texture != NULL) SDL_DestroyTexture(c->texture);
+    if (c->texture != NULL && c->owns_texture) SDL_DestroyTexture(c->texture);
+    free(c->vertices.data);
+    free(c->indices.data);
+    free(c->cells);
+    free(c->shown);
+    free(c->glyphs);
 }
 
-void console_print(rg_console *c, int x, int y, int ch, SDL_Color color)
+// Sends the collected quads to the current render target. Fills replace what
+// is under them, alpha included.
+void console_submit(rg_console *c)
 {
-    int idx = -1;
-    for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
+    if (c->vertices.len > 0)
     {
-        if (ch == c->tileset->char_indices[i])
-        {
-            idx = i;
-            break;
-        }
+        SDL_BlendMode mode;
+        SDL_GetRenderDrawBlendMode(c->renderer, &mode);
+        if (!c->batch_textured)
+            SDL_SetRenderDrawBlendMode(c->renderer, SDL_BLENDMODE_NONE);
+        SDL_RenderGeometry(c->renderer,
+                           c->batch_textured ? c->tileset->texture : NULL,
+                           c->vertices.data,
+                           (int)c->vertices.len,
+                           c->indices.data,
+                           (int)c->indices.len);
+        SDL_SetRenderDrawBlendMode(c->renderer, mode);
     }
-    if (idx == -1)
+    c->vertices.len = 0;
+    c->indices.len = 0;
+}
+
+// `src` is NULL for an untextured fill.
+static void console_push_quad(rg_console *c,
+                              const SDL_Rect *dest,
+                              const SDL_Rect *src,
+                              SDL_Color color)
+{
+    const bool textured = src != NULL;
+    if (textured != c->batch_textured)
     {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                    "unsupported char %c supplied to print.",
-                    ch);
-        return;
+        console_submit(c);
+        c->batch_textured = textured;
     }
 
-    SDL_SetTextureColorMod(c->tileset->texture, color.r, color.g, color.b);
-    SDL_SetTextureAlphaMod(c->tileset->texture, color.a);
+    float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+    if (textured)
+    {
+        const float tw = (float)c->tileset->texture_width;
+        const float th = (float)c->tileset->texture_height;
+        u0 = src->x / tw;
+        v0 = src->y / th;
+        u1 = (src->x + src->w) / tw;
+        v1 = (src->y + src->h) / th;
+    }
+    const float x0 = (float)dest->x;
+    const float y0 = (float)dest->y;
+    const float x1 = (float)(dest->x + dest->w);
+    const float y1 = (float)(dest->y + dest->h);
+
+    const int base = (int)c->vertices.len;
+    ARRAY_PUSH(&c->vertices,
+               ((SDL_Vertex){ { x0, y0 }, color, { u0, v0 } }));
+    ARRAY_PUSH(&c->vertices,
+               ((SDL_Vertex){ { x1, y0 }, color, { u1, v0 } }));
+    ARRAY_PUSH(&c->vertices,
+               ((SDL_Vertex){ { x0, y1 }, color, { u0, v1 } }));
+    ARRAY_PUSH(&c->vertices,
+               ((SDL_Vertex){ { x1, y1 }, color, { u1, v1 } }));
+    static const int corners[6] = { 0, 1, 2, 2, 1, 3 };
+    for (int i = 0; i < 6; i++) ARRAY_PUSH(&c->indices, base + corners[i]);
+}
 
-    SDL_Rect *src = &c->tileset->srcs[idx];
+void console_print(rg_console *c, int x, int y, int ch, SDL_Color color)
+{
+    if (x < 0 || x >= c->width || y < 0 || y >= c->height) return;
 
-    SDL_Rect dest = { x * c->tileset->tile_size,
-                      y * c->tileset->tile_size,
-                      c->tileset->tile_size,
-                      c->tileset->tile_size };
+    rg_console_cell *cell = &c->cells[x + y * c->width];
+    cell->ch = ch;
+    cell->fg = color;
+}
 
-    SDL_RenderCopy(c->renderer, c->tileset->texture, src, &dest);
+// Decodes the codepoint at *s and moves past it. Malformed sequences come out
+// as U+FFFD one byte at a time.
+static int utf8_next(const char **s)
+{
+    const unsigned char *p = (const unsigned char *)*s;
+    int len = 0;
+    if (p[0] < 0x80)
+        len = 1;
+    else if ((p[0] & 0xe0) == 0xc0)
+        len = 2;
+    else if ((p[0] & 0xf0) == 0xe0)
+        len = 3;
+    else if ((p[0] & 0xf8) == 0xf0)
+        len = 4;
+    int ch = p[0] & (len == 1 ? 0x7f : 0xff >> (len + 1));
+    for (int i = 1; i < len; i++)
+    {
+        // Also stops at the terminator of a cut off sequence.
+        if ((p[i] & 0xc0) != 0x80)
+        {
+            len = 0;
+            break;
+        }
+        ch = (ch << 6) | (p[i] & 0x3f);
+    }
+    // Overlong forms, surrogates and values past the last plane.
+    static const int min_of_len[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (len == 0 || ch < min_of_len[len] || ch > 0x10ffff ||
+        (ch >= 0xd800 && ch <= 0xdfff))
+    {
+        *s += 1;
+        return 0xfffd;
+    }
+    *s += len;
+    return ch;
 }
 
 void console_print_txt(rg_console *c,
@@ -73,9 +163,8 @@ void console_print_txt(rg_console *c,
     int penx = x, peny = y;
     while (*txt != '\0')
     {
-        console_print(c, penx, peny, *txt, color);
+        console_print(c, penx, peny, utf8_next(&txt), color);
         penx += 1;
-        txt++;
     }
 }
 
@@ -84,6 +173,7 @@ void console_fill(rg_console *c, int x, int y, SDL_Color color)
     console_fill_rect(c, x, y, 1, 1, color);
 }
 
+// Covers the cells, glyphs included, as drawing a filled rect did.
 void console_fill_rect(rg_console *c,
                        int x,
                        int y,
@@ -91,53 +181,152 @@ void console_fill_rect(rg_console *c,
                        int h,
                        SDL_Color color)
 {
-    SDL_SetRenderDrawColor(c->renderer, color.r, color.g, color.b, color.a);
-    SDL_Rect dest = { .x = x * c->tileset->tile_size,
-                      .y = y * c->tileset->tile_size,
-                      .w = w * c->tileset->tile_size,
-                      .h = h * c->tileset->tile_size };
-    SDL_RenderFillRect(c->renderer, &dest);
+    const int x0 = MAX(x, 0);
+    const int y0 = MAX(y, 0);
+    const int x1 = MIN(x + w, c->width);
+    const int y1 = MIN(y + h, c->height);
+    for (int cy = y0; cy < y1; cy++)
+    {
+        for (int cx = x0; cx < x1; cx++)
+        {
+            rg_console_cell *cell = &c->cells[cx + cy * c->width];
+            cell->ch = -1;
+            cell->bg = color;
+        }
+    }
 }
 
-void console_draw_rect(rg_console *c,
-                       int x,
-                       int y,
-                       int w,
-                       int h,
-                       SDL_Color color)
+void console_clear(rg_console *c, SDL_Color color)
 {
-    SDL_SetRenderDrawColor(c->renderer, color.r, color.g, color.b, color.a);
-    SDL_Rect dest = { .x = x * c->tileset->tile_size,
-                      .y = y * c->tileset->tile_size,
-                      .w = w * c->tileset->tile_size,
-                      .h = h * c->tileset->tile_size };
-    SDL_RenderDrawRect(c->renderer, &dest);
+    const rg_console_cell blank = { .ch = -1, .fg = color, .bg = color };
+    for (int i = 0; i < c->width * c->height; i++) c->cells[i] = blank;
 }
 
-void console_clear(rg_console *c, SDL_Color color)
+void console_begin(rg_console *c)
 {
-    SDL_SetRenderDrawColor(c->renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderClear(c->renderer);
+    ASSERT_M(c->cells != NULL);
 }
 
-void console_begin(rg_console *c)
+static bool console_cell_equal(const rg_console_cell *a,
+                               const rg_console_cell *b)
 {
+    return a->ch == b->ch && memcmp(&a->bg, &b->bg, sizeof(a->bg)) == 0 &&
+           (a->ch == -1 || memcmp(&a->fg, &b->fg, sizeof(a->fg)) == 0);
+}
+
+static void console_create_texture(rg_console *c)
+{
+    SDL_DisplayMode mode;
+    SDL_GetCurrentDisplayMode(0, &mode);
+
+    int render_w = c->width * c->tileset->tile_size;
+    int render_h = c->height * c->tileset->tile_size;
+    c->texture = SDL_CreateTexture(
+      c->renderer, mode.format, SDL_TEXTUREACCESS_TARGET, render_w, render_h);
     ASSERT_M(c->texture != NULL);
-    SDL_SetRenderTarget(c->renderer, c->texture);
+    SDL_SetTextureBlendMode(c->texture, SDL_BLENDMODE_BLEND);
+    c->owns_texture = true;
+    c->stale = true; // the texture starts out undefined
+}
+
+// Draws into a region of `t` from now on, the console doesn't own it. The
+// region is the console's size at pixel (x, y).
+void console_attach(rg_console *c, SDL_Texture *t, int x, int y)
+{
+    if (c->texture != NULL && c->owns_texture) SDL_DestroyTexture(c->texture);
+    c->texture = t;
+    c->owns_texture = false;
+    c->origin = (SDL_Point){ x, y };
+    c->stale = true;
 }
 
+// Resolves the glyphs of the cells that differ from what the texture shows.
+// Returns false when there is nothing to paint.
+bool console_prepare(rg_console *c)
+{
+    if (c->texture == NULL) console_create_texture(c);
+    if (c->targets_epoch != console_targets_epoch) c->stale = true;
+    const int len = c->width * c->height;
+
+    // Glyphs are resolved before any quad is queued, loading one may grow
+    // the atlas texture the queued quads would point into.
+    bool changed = false;
+    for (int i = 0; i < len; i++)
+    {
+        const rg_console_cell *cell = &c->cells[i];
+        c->glyphs[i] = -1;
+        if (!c->stale && console_cell_equal(cell, &c->shown[i])) continue;
+        changed = true;
+        if (cell->ch == -1) continue;
+        c->glyphs[i] = (int16_t)tileset_glyph(c->tileset, cell->ch);
+        if (c->glyphs[i] == -1)
+        {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "unsupported char U+%04X supplied to print.",
+                        cell->ch);
+        }
+    }
+    return changed || c->stale;
+}
+
+// Renders the cells found by console_prepare into the current render target,
+// which has to be the console's texture. Backgrounds go in one batch and
+// glyphs on top in another.
+void console_paint(rg_console *c)
+{
+    const int ts = c->tileset->tile_size;
+    const int len = c->width * c->height;
+    for (int i = 0; i < len; i++)
+    {
+        if (!c->stale && console_cell_equal(&c->cells[i], &c->shown[i]))
+            continue;
+        const SDL_Rect dest = { .x = c->origin.x + (i % c->width) * ts,
+                                .y = c->origin.y + (i / c->width) * ts,
+                                .w = ts,
+                                .h = ts };
+        console_push_quad(c, &dest, NULL, c->cells[i].bg);
+    }
+    console_submit(c);
+    for (int i = 0; i < len; i++)
+    {
+        if (c->glyphs[i] == -1) continue;
+        const SDL_Rect dest = { .x = c->origin.x + (i % c->width) * ts,
+                                .y = c->origin.y + (i / c->width) * ts,
+                                .w = ts,
+                                .h = ts };
+        console_push_quad(
+          c, &dest, &c->tileset->srcs[c->glyphs[i]], c->cells[i].fg);
+    }
+    console_submit(c);
+    memcpy(c->shown, c->cells, sizeof(*c->shown) * len);
+    c->stale = false;
+    c->targets_epoch = console_targets_epoch;
+}
+
+// Renders the cells that differ from what the texture shows, switching the
+// render target only when there is something to paint.
 void console_end(rg_console *c)
 {
+    if (!console_prepare(c)) return;
+    SDL_SetRenderTarget(c->renderer, c->texture);
+    console_paint(c);
     SDL_SetRenderTarget(c->renderer, NULL);
 }
 
+void console_targets_reset(void)
+{
+    console_targets_epoch++;
+}
+
 void console_flush(rg_console *c, int x, int y)
 {
     ASSERT_M(c->texture != NULL);
 
-    SDL_Rect dest = { .x = x * c->tileset->tile_size,
-                      .y = y * c->tileset->tile_size,
-                      .w = c->width * c->tileset->tile_size,
-                      .h = c->height * c->tileset->tile_size };
-    SDL_RenderCopy(c->renderer, c->texture, NULL, &dest);
+    const int ts = c->tileset->tile_size;
+    const SDL_Rect src = { .x = c->origin.x,
+                           .y = c->origin.y,
+                           .w = c->width * ts,
+                           .h = c->height * ts };
+    const SDL_Rect dest = { .x = x * ts, .y = y * ts, .w = src.w, .h = src.h };
+    SDL_RenderCopy(c->renderer, c->texture, &src, &dest);
 }
\ No newline at end of file
@@ -1,10 +1,45 @@
 #ifndef CONSOLE_H
 #define CONSOLE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include <SDL.h>
 
 #include "tileset.h"
 
+typedef struct rg_vertices
+{
+    size_t len;
+    size_t capacity;
+    SDL_Vertex *data;
+} rg_vertices;
+
+typedef struct rg_vertex_indices
+{
+    size_t len;
+    size_t capacity;
+    int *data;
+} rg_vertex_indices;
+
+typedef struct rg_console_cell
+{
+    int32_t ch; // codepoint, -1 for none
+    SDL_Color fg;
+    SDL_Color bg;
+} rg_console_cell;
+
+// Drawing fills in a grid of cells, console_end renders only the cells that
+// differ from the ones the texture was last rendered with. Filling cells
+// doesn't touch the renderer or the tileset, so it can happen on any thread;
+// the texture is made on the first end. Consoles attached to one shared
+// texture are painted with console_prepare and console_paint instead, so a
+// single render target switch covers all of them.
+//
+// Glyphs and fills are collected as quads with per vertex colors and sent in
+// one SDL_RenderGeometry call. The batch holds either glyphs or untextured
+// fills, switching between them or drawing outside the batch submits it.
 typedef struct rg_console
 {
     int width;
@@ -12,6 +47,16 @@ typedef struct rg_console
     rg_tileset *tileset;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    bool owns_texture; // false when drawing into a shared texture
+    SDL_Point origin;  // of the console's region in the texture, in pixels
+    rg_vertices vertices;
+    rg_vertex_indices indices;
+    bool batch_textured;
+    rg_console_cell *cells; // being drawn
+    rg_console_cell *shown; // what the texture holds
+    int16_t *glyphs;        // scratch for the end, tileset index per cell
+    bool stale;             // repaint every cell on the next end
+    unsigned targets_epoch;
 } rg_console;
 
 void console_create(rg_console *c,
@@ -34,16 +79,15 @@ void console_fill_rect(rg_console *c,
                        int w,
                        int h,
                        SDL_Color color);
-void console_draw_rect(rg_console *c,
-                       int x,
-                       int y,
-                       int w,
-                       int h,
-                       SDL_Color color);
 
 void console_clear(rg_console *c, SDL_Color color);
 void console_begin(rg_console *c);
+void console_attach(rg_console *c, SDL_Texture *t, int x, int y);
+bool console_prepare(rg_console *c);
+void console_paint(rg_console *c);
 void console_end(rg_console *c);
+void console_submit(rg_console *c);
+void console_targets_reset(void);
 void console_flush(rg_console *c, int x, int y);
 
 #endif
\ No newline at end of file
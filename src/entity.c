@@ -8,15 +8,119 @@
 #include "color.h"
 #include "types.h"
 
+const rg_entity_proto entity_prototypes[ENTITY_PROTO_LEN] = {
+    [ENTITY_PROTO_PLAYER] = {
+      .name = "Player",
+      .corpse_name = "Player",
+      .ch = '@',
+      .color = WHITE_INIT,
+      .blocks = true,
+      .type = ENTITY_PLAYER,
+      .render_order = RENDER_ORDER_ACTOR,
+      .state = ENTITY_STATE_NONE,
+      .fighter = { .hp = 100, .defence = 1, .power = 2, .max_hp = 100 },
+    },
+    [ENTITY_PROTO_ORC] = {
+      .name = "Orc",
+      .corpse_name = "remains of Orc",
+      .ch = 'o',
+      .color = GREEN_INIT,
+      .blocks = true,
+      .type = ENTITY_BASIC_MONSTER,
+      .render_order = RENDER_ORDER_ACTOR,
+      .state = ENTITY_STATE_FOLLOW_PLAYER,
+      .fighter = { .hp = 20, .defence = 0, .power = 4, .xp = 35 },
+    },
+    [ENTITY_PROTO_TROLL] = {
+      .name = "Troll",
+      .corpse_name = "remains of Troll",
+      .ch = 'T',
+      .color = DARKER_GREEN_INIT,
+      .blocks = true,
+      .type = ENTITY_BASIC_MONSTER,
+      .render_order = RENDER_ORDER_ACTOR,
+      .state = ENTITY_STATE_FOLLOW_PLAYER,
+      .fighter = { .hp = 30, .defence = 2, .power = 8, .xp = 100 },
+    },
+    [ENTITY_PROTO_STAIRS] = {
+      .name = "Stairs",
+      .corpse_name = "Stairs",
+      .ch = '>',
+      .color = WHITE_INIT,
+      .blocks = false,
+      .type = ENTITY_STAIRS,
+      .render_order = RENDER_ORDER_STAIRS,
+      .state = ENTITY_STATE_NONE,
+    },
+    [ENTITY_PROTO_STAIRS_UP] = {
+      .name = "Up stairs",
+      .corpse_name = "Up stairs",
+      .ch = '<',
+      .color = WHITE_INIT,
+      .blocks = false,
+      .type = ENTITY_STAIRS_UP,
+      .render_order = RENDER_ORDER_STAIRS,
+      .state = ENTITY_STATE_NONE,
+    },
+};
+
+void entity_create(rg_entity* e, rg_entity_proto_id proto, int x, int y)
+{
+    ASSERT_M(proto < ENTITY_PROTO_LEN);
+    memset(e, 0, sizeof(*e));
+    e->x = x;
+    e->y = y;
+    e->proto = proto;
+    e->dead = false;
+    e->state.type = entity_prototypes[proto].state;
+    e->fighter = entity_prototypes[proto].fighter;
+}
+
+const rg_entity_proto* entity_proto(const rg_entity* e)
+{
+    return &entity_prototypes[e->proto];
+}
+
+const char* entity_name(const rg_entity* e)
+{
+    return e->dead ? entity_proto(e)->corpse_name : entity_proto(e)->name;
+}
+
+char entity_glyph(const rg_entity* e)
+{
+    return e->dead ? '%' : entity_proto(e)->ch;
+}
+
+SDL_Color entity_color(const rg_entity* e)
+{
+    return e->dead ? DARK_RED : entity_proto(e)->color;
+}
+
+bool entity_blocks(const rg_entity* e)
+{
+    return !e->dead && entity_proto(e)->blocks;
+}
+
+rg_entity_type entity_type(const rg_entity* e)
+{
+    return entity_proto(e)->type;
+}
+
+rg_render_order entity_render_order(const rg_entity* e)
+{
+    return e->dead ? RENDER_ORDER_CORPSE : entity_proto(e)->render_order;
+}
+
 void entity_move(rg_entity* e, int dx, int dy)
 {
     e->x += dx;
     e->y += dy;
 }
 
-void entity_draw(const rg_entity* e, rg_console* c)
+void entity_draw(const rg_entity* e, rg_console* c, int cam_x, int cam_y)
 {
-    console_print(c, e->x, e->y, e->ch, e->color);
+    console_print(
+      c, e->x - cam_x, e->y - cam_y, entity_glyph(e), entity_color(e));
 }
 
 void entity_get_at_loc(rg_entity_array* entities,
@@ -27,7 +131,7 @@ void entity_get_at_loc(rg_entity_array* entities,
     for (int i = 0; i < entities->len; i++)
     {
         rg_entity* e = &entities->data[i];
-        if (e->blocks && e->x == x && e->y == y)
+        if (entity_blocks(e) && e->x == x && e->y == y)
         {
             *entity = e;
             return;
@@ -62,11 +166,13 @@ void entity_attack(rg_entity* e,
 {
     ASSERT_M(dead_entity != NULL);
     *dead_entity = NULL;
+    const char* name = entity_name(e);
+    const char* target_name = entity_name(target);
     int power = e->fighter.power;
     int defence = target->fighter.defence;
-    if (e->type == ENTITY_PLAYER)
+    if (entity_type(e) == ENTITY_PLAYER)
         power += equipment_get_power_bonus(player_equipments);
-    if (target->type == ENTITY_PLAYER)
+    if (entity_type(target) == ENTITY_PLAYER)
         defence += equipment_get_defense_bonus(player_equipments);
     int damage = power - defence;
     if (damage > 0)
@@ -76,9 +182,9 @@ void entity_attack(rg_entity* e,
 
         const char* fmt = "%s attacks %s for %d hit points";
 
-        int len = snprintf(NULL, 0, fmt, e->name, target->name, damage);
+        int len = snprintf(NULL, 0, fmt, name, target_name, damage);
         char* buf = malloc(sizeof(char) * (len + 1));
-        snprintf(buf, len, fmt, e->name, target->name, damage);
+        snprintf(buf, len, fmt, name, target_name, damage);
 
         rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                     .text = buf,
@@ -94,10 +200,10 @@ void entity_attack(rg_entity* e,
     {
         const char* fmt = "%s attacks %s but does no damage";
 
-        long len = snprintf(NULL, 0, fmt, e->name, target->name);
+        long len = snprintf(NULL, 0, fmt, name, target_name);
         size_t sz = len + 1;
         char* buf = malloc(sizeof(char) * sz);
-        snprintf(buf, len, fmt, e->name, target->name);
+        snprintf(buf, len, fmt, name, target_name);
 
         rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                     .text = buf,
@@ -110,28 +216,19 @@ void entity_kill(rg_entity* e, rg_turn_logs* logs)
 {
     ASSERT_M(e != NULL);
     ASSERT_M(logs != NULL);
-    e->ch = '%';
-    e->color = DARK_RED;
-    e->blocks = false;
-    e->render_order = RENDER_ORDER_CORPSE;
+    e->dead = true;
     e->state.type = ENTITY_STATE_NONE;
 
     rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE };
-    if (e->type != ENTITY_PLAYER)
+    if (entity_type(e) != ENTITY_PLAYER)
     {
-
+        const char* name = entity_proto(e)->name;
         const char* logfmt = "%s is dead!";
-        const int sz1 = snprintf(NULL, 0, logfmt, e->name);
+        const int sz1 = snprintf(NULL, 0, logfmt, name);
         entry.text = malloc(sizeof(char) * sz1 + 1);
         entry.color = ORANGE;
-        snprintf(entry.text, sz1 + 1, logfmt, e->name);
+        snprintf(entry.text, sz1 + 1, logfmt, name);
         turn_logs_push(logs, &entry);
-
-        char* buf = strdup(e->name);
-        const char* fmt = "remains of %s";
-        const int sz = snprintf(NULL, 0, fmt, buf);
-        snprintf(e->name, sz + 1, fmt, buf);
-        free(buf);
     }
     else
     {
@@ -154,4 +251,11 @@ float entity_distance_to(rg_entity* a, int x, int y)
     int dx = x - a->x;
     int dy = y - a->y;
     return (float)sqrt(dx * dx + dy * dy);
+}
+
+int entity_distance_sq_to(const rg_entity* a, int x, int y)
+{
+    int dx = x - a->x;
+    int dy = y - a->y;
+    return dx * dx + dy * dy;
 }
\ No newline at end of file
@@ -9,8 +9,6 @@
 #include "equipment.h"
 #include "turn_log.h"
 
-#define MAX_ENTITY_NAME 50
-
 typedef enum rg_entity_state_type
 {
     ENTITY_STATE_NONE,          // IDLE
@@ -19,14 +17,6 @@ typedef enum rg_entity_state_type
     ENTITY_STATE_CONFUSED,
 } rg_entity_state_type;
 
-typedef enum rg_monster_type
-{
-    MONSTER_ORC,
-    MONSTER_TROLL,
-
-    MONSTER_LEN,
-} rg_monster_type;
-
 typedef struct rg_entity_state
 {
     rg_entity_state_type type;
@@ -48,6 +38,7 @@ typedef enum rg_entity_type
     ENTITY_PLAYER,
     ENTITY_BASIC_MONSTER,
     ENTITY_STAIRS,
+    ENTITY_STAIRS_UP,
 } rg_entity_type;
 
 typedef enum rg_render_order
@@ -55,6 +46,8 @@ typedef enum rg_render_order
     RENDER_ORDER_STAIRS,
     RENDER_ORDER_CORPSE,
     RENDER_ORDER_ACTOR,
+
+    RENDER_ORDER_LEN,
 } rg_render_order;
 
 typedef struct rg_fighter
@@ -66,17 +59,40 @@ typedef struct rg_fighter
     int xp;
 } rg_fighter;
 
-typedef struct rg_entity
+typedef enum rg_entity_proto_id
 {
-    int x, y;
+    ENTITY_PROTO_PLAYER,
+    ENTITY_PROTO_ORC,
+    ENTITY_PROTO_TROLL,
+    ENTITY_PROTO_STAIRS,
+    ENTITY_PROTO_STAIRS_UP,
+
+    ENTITY_PROTO_LEN,
+} rg_entity_proto_id;
+
+// Immutable data shared by every entity of a kind.
+typedef struct rg_entity_proto
+{
+    const char *name;
+    const char *corpse_name;
     char ch;
     SDL_Color color;
-    char name[MAX_ENTITY_NAME];
     bool blocks;
     rg_entity_type type;
+    rg_render_order render_order;
+    rg_entity_state_type state;
+    rg_fighter fighter;
+} rg_entity_proto;
+
+extern const rg_entity_proto entity_prototypes[ENTITY_PROTO_LEN];
+
+typedef struct rg_entity
+{
+    int x, y;
+    rg_entity_proto_id proto;
+    bool dead;
     rg_entity_state state;
     rg_fighter fighter;
-    rg_render_order render_order;
 } rg_entity;
 
 typedef struct rg_entity_array
@@ -86,8 +102,17 @@ typedef struct rg_entity_array
     rg_entity *data;
 } rg_entity_array;
 
+void entity_create(rg_entity *e, rg_entity_proto_id proto, int x, int y);
+const rg_entity_proto *entity_proto(const rg_entity *e);
+const char *entity_name(const rg_entity *e);
+char entity_glyph(const rg_entity *e);
+SDL_Color entity_color(const rg_entity *e);
+bool entity_blocks(const rg_entity *e);
+rg_entity_type entity_type(const rg_entity *e);
+rg_render_order entity_render_order(const rg_entity *e);
+
 void entity_move(rg_entity *e, int dx, int dy);
-void entity_draw(const rg_entity *e, rg_console *c);
+void entity_draw(const rg_entity *e, rg_console *c, int cam_x, int cam_y);
 
 void entity_get_at_loc(rg_entity_array *entities,
                        int x,
@@ -107,4 +132,5 @@ void entity_attack(rg_entity *e,
 void entity_kill(rg_entity *e, rg_turn_logs *logs);
 float entity_get_distance(rg_entity *a, rg_entity *b);
 float entity_distance_to(rg_entity *a, int x, int y);
+int entity_distance_sq_to(const rg_entity *a, int x, int y);
 #endif
\ No newline at end of file
@@ -13,7 +13,7 @@ void equipment_toggle_equip(rg_player_equipments* e,
     {
         *len = 0;
     }
-    if (i->equipable.slot == EQUIPMENT_SLOT_MAIN_HAND)
+    if (item_proto(i)->equipable.slot == EQUIPMENT_SLOT_MAIN_HAND)
     {
         if (e->main_hand == i)
         {
@@ -44,7 +44,7 @@ void equipment_toggle_equip(rg_player_equipments* e,
             e->main_hand = i;
         }
     }
-    else if (i->equipable.slot == EQUIPMENT_SLOT_OFF_HAND)
+    else if (item_proto(i)->equipable.slot == EQUIPMENT_SLOT_OFF_HAND)
     {
         if (e->off_hand == i)
         {
@@ -76,32 +76,39 @@ void equipment_toggle_equip(rg_player_equipments* e,
     }
 }
 
+static const rg_item_proto* equipped_proto(rg_item* i)
+{
+    if (i == NULL) return NULL;
+    const rg_item_proto* proto = item_proto(i);
+    return proto->type == ITEM_EQUIPMENT ? proto : NULL;
+}
+
 int equipment_get_max_hp_bonus(rg_player_equipments* e)
 {
     int b = 0;
-    if (e->main_hand != NULL && e->main_hand->type == ITEM_EQUIPMENT)
-        b += e->main_hand->equipable.max_hp_bonus;
-    if (e->off_hand != NULL && e->off_hand->type == ITEM_EQUIPMENT)
-        b += e->off_hand->equipable.max_hp_bonus;
+    const rg_item_proto* main = equipped_proto(e->main_hand);
+    const rg_item_proto* off = equipped_proto(e->off_hand);
+    if (main != NULL) b += main->equipable.max_hp_bonus;
+    if (off != NULL) b += off->equipable.max_hp_bonus;
     return b;
 }
 
 int equipment_get_power_bonus(rg_player_equipments* e)
 {
     int b = 0;
-    if (e->main_hand != NULL && e->main_hand->type == ITEM_EQUIPMENT)
-        b += e->main_hand->equipable.power_bonus;
-    if (e->off_hand != NULL && e->off_hand->type == ITEM_EQUIPMENT)
-        b += e->off_hand->equipable.power_bonus;
+    const rg_item_proto* main = equipped_proto(e->main_hand);
+    const rg_item_proto* off = equipped_proto(e->off_hand);
+    if (main != NULL) b += main->equipable.power_bonus;
+    if (off != NULL) b += off->equipable.power_bonus;
     return b;
 }
 
 int equipment_get_defense_bonus(rg_player_equipments* e)
 {
     int b = 0;
-    if (e->main_hand != NULL && e->main_hand->type == ITEM_EQUIPMENT)
-        b += e->main_hand->equipable.defense_bonus;
-    if (e->off_hand != NULL && e->off_hand->type == ITEM_EQUIPMENT)
-        b += e->off_hand->equipable.defense_bonus;
+    const rg_item_proto* main = equipped_proto(e->main_hand);
+    const rg_item_proto* off = equipped_proto(e->off_hand);
+    if (main != NULL) b += main->equipable.defense_bonus;
+    if (off != NULL) b += off->equipable.defense_bonus;
     return b;
 }
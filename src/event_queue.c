@@ -0,0 +1,54 @@
+#include "event_queue.h"
+
+#include <string.h>
+
+#include "types.h"
+
+void event_queue_create(rg_event_queue* q)
+{
+    memset(q, 0, sizeof(*q));
+    q->pushed = SDL_CreateSemaphore(0);
+    ASSERT_M(q->pushed != NULL);
+}
+
+void event_queue_destroy(rg_event_queue* q)
+{
+    SDL_DestroySemaphore(q->pushed);
+    memset(q, 0, sizeof(*q));
+}
+
+// Returns false when the queue is full, the event is dropped.
+bool event_queue_push(rg_event_queue* q, const SDL_Event* event)
+{
+    const unsigned tail = (unsigned)SDL_AtomicGet(&q->tail);
+    const unsigned head = (unsigned)SDL_AtomicGet(&q->head);
+    if (tail - head == EVENT_QUEUE_LEN) return false;
+    q->events[tail & (EVENT_QUEUE_LEN - 1)] = *event;
+    SDL_AtomicSet(&q->tail, (int)(tail + 1));
+    SDL_SemPost(q->pushed);
+    return true;
+}
+
+bool event_queue_pop(rg_event_queue* q, SDL_Event* event)
+{
+    const unsigned head = (unsigned)SDL_AtomicGet(&q->head);
+    if (head == (unsigned)SDL_AtomicGet(&q->tail)) return false;
+    *event = q->events[head & (EVENT_QUEUE_LEN - 1)];
+    SDL_AtomicSet(&q->head, (int)(head + 1));
+    return true;
+}
+
+// Sleeps until something was pushed since the last wait. Pops don't have to
+// match waits, a wait may return with the queue already drained.
+void event_queue_wait(rg_event_queue* q)
+{
+    SDL_SemWait(q->pushed);
+    while (SDL_SemTryWait(q->pushed) == 0)
+        ;
+}
+
+// Ends a wait without pushing anything.
+void event_queue_wake(rg_event_queue* q)
+{
+    SDL_SemPost(q->pushed);
+}
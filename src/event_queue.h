@@ -0,0 +1,28 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+// Power of two.
+#define EVENT_QUEUE_LEN 256
+
+// Passes events from one producer thread to one consumer thread without
+// locks. The semaphore counts pushed events so the consumer can sleep.
+typedef struct rg_event_queue
+{
+    SDL_Event events[EVENT_QUEUE_LEN];
+    SDL_atomic_t head; // next to pop, written by the consumer
+    SDL_atomic_t tail; // next to push, written by the producer
+    SDL_sem* pushed;
+} rg_event_queue;
+
+void event_queue_create(rg_event_queue* q);
+void event_queue_destroy(rg_event_queue* q);
+bool event_queue_push(rg_event_queue* q, const SDL_Event* event);
+bool event_queue_pop(rg_event_queue* q, SDL_Event* event);
+void event_queue_wait(rg_event_queue* q);
+void event_queue_wake(rg_event_queue* q);
+
+#endif
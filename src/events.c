@@ -19,25 +19,18 @@ void event_dispatch(rg_app *app,
         break;
     case SDL_MOUSEMOTION:
     {
+        // SDL already scales motion to the logical size, this runs off the
+        // thread that owns the renderer so it can't be asked.
+        const int rw = app->screen_width * tile_width;
+        const int rh = app->screen_height * tile_height;
         mouse_position->x = event->motion.x;
         mouse_position->y = event->motion.y;
-
-        int wx, wy;
-        SDL_GetMouseState(&wx, &wy);
-        float lx, ly;
-        SDL_RenderWindowToLogical(app->renderer, wx, wy, &lx, &ly);
-        int rw, rh;
-        SDL_RenderGetLogicalSize(app->renderer, &rw, &rh);
-        if (lx < 0) mouse_position->x = 0;
-        else if (lx > rw)
-            mouse_position->x = rw;
-        else
-            mouse_position->x = (int)lx;
-        if (ly < 0) mouse_position->y = 0;
-        else if (ly > rh)
-            mouse_position->y = rh;
-        else
-            mouse_position->y = (int)ly;
+        if (mouse_position->x < 0) mouse_position->x = 0;
+        else if (mouse_position->x >= rw)
+            mouse_position->x = rw - 1;
+        if (mouse_position->y < 0) mouse_position->y = 0;
+        else if (mouse_position->y >= rh)
+            mouse_position->y = rh - 1;
 
         mouse_position->x = mouse_position->x / tile_width;
         mouse_position->y = mouse_position->y / tile_height;
@@ -48,3 +41,22 @@ void event_dispatch(rg_app *app,
         break;
     }
 }
+
+// Input that may change what is on screen without changing the game state,
+// and events after which the window has to be painted again.
+bool event_forces_redraw(const SDL_Event *event)
+{
+    switch (event->type)
+    {
+    case SDL_KEYDOWN:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEWHEEL:
+    case SDL_WINDOWEVENT:
+    case SDL_RENDER_TARGETS_RESET:
+    case SDL_RENDER_DEVICE_RESET:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -1,6 +1,8 @@
 #ifndef EVENTS_H
 #define EVENTS_H
 
+#include <stdbool.h>
+
 #include <SDL.h>
 
 typedef enum rg_action_type
@@ -49,5 +51,6 @@ void event_dispatch(struct rg_app* app,
                     SDL_Point* mouse_position,
                     int tile_width,
                     int tile_height);
+bool event_forces_redraw(const SDL_Event* event);
 
 #endif
\ No newline at end of file
@@ -68,13 +68,13 @@ void fov_map_create(rg_fov_map *m, int w, int h)
     memset(m, 0, sizeof(*m));
     m->width = w;
     m->height = h;
-    m->cells = calloc(m->width * m->height, sizeof(*m->cells));
+    m->fov = calloc(m->width * m->height, sizeof(*m->fov));
 }
 
 void fov_map_destroy(rg_fov_map *m)
 {
     if (m == NULL) return;
-    free(m->cells);
+    free(m->fov);
 }
 
 bool fov_map_in_bounds(rg_fov_map *m, int x, int y)
@@ -86,29 +86,11 @@ bool fov_map_in_bounds(rg_fov_map *m, int x, int y)
 bool fov_map_is_in_fov(rg_fov_map *m, int x, int y)
 {
     if (!fov_map_in_bounds(m, x, y)) return false;
-    return m->cells[x + y * m->width].fov;
-}
-
-bool fov_map_is_walkable(rg_fov_map *m, int x, int y)
-{
-    if (!fov_map_in_bounds(m, x, y))
-        return false;
-    return m->cells[x + y * m->width].walkable;
-}
-
-void fov_map_set_props(rg_fov_map *m,
-                       int x,
-                       int y,
-                       bool transparent,
-                       bool walkable)
-{
-    if (!fov_map_in_bounds(m, x, y)) return;
-    size_t idx = x + y * m->width;
-    m->cells[idx].transparent = transparent;
-    m->cells[idx].walkable = walkable;
+    return m->fov[x + y * m->width];
 }
 
 void fov_map_cast_ray(rg_fov_map *m,
+                      const rg_tile_view *v,
                       int orig_x,
                       int orig_y,
                       int dest_x,
@@ -137,20 +119,21 @@ void fov_map_cast_ray(rg_fov_map *m,
             }
         }
         const int map_index = current_x + current_y * m->width;
-        if (!m->cells[map_index].transparent)
+        if (!tile_view_is_transparent(v, current_x, current_y))
         {
             if (light_walls)
             {
-                m->cells[map_index].fov = true;
+                m->fov[map_index] = true;
             }
             return; // Blocked by wall.
         }
         // Tile is transparent.
-        m->cells[map_index].fov = true;
+        m->fov[map_index] = true;
     }
 }
 
 void fov_map_postprocess_quad(rg_fov_map *m,
+                              const rg_tile_view *v,
                               int x0,
                               int y0,
                               int x1,
@@ -169,34 +152,34 @@ void fov_map_postprocess_quad(rg_fov_map *m,
             const int x2 = cx + dx;
             const int y2 = cy + dy;
             const int offset = cx + cy * m->width;
-            if (offset < (m->width * m->height) && m->cells[offset].fov == 1 &&
-                m->cells[offset].transparent)
+            if (offset < (m->width * m->height) && m->fov[offset] &&
+                tile_view_is_transparent(v, cx, cy))
             {
                 if (x2 >= x0 && x2 <= x1)
                 {
                     const int offset2 = x2 + cy * m->width;
                     if (offset2 < (m->width * m->height) &&
-                        !m->cells[offset2].transparent)
+                        !tile_view_is_transparent(v, x2, cy))
                     {
-                        m->cells[offset2].fov = true;
+                        m->fov[offset2] = true;
                     }
                 }
                 if (y2 >= y0 && y2 <= y1)
                 {
                     const int offset2 = cx + y2 * m->width;
                     if (offset2 < (m->width * m->height) &&
-                        !m->cells[offset2].transparent)
+                        !tile_view_is_transparent(v, cx, y2))
                     {
-                        m->cells[offset2].fov = true;
+                        m->fov[offset2] = true;
                     }
                 }
                 if (x2 >= x0 && x2 <= x1 && y2 >= y0 && y2 <= y1)
                 {
                     const int offset2 = x2 + y2 * m->width;
                     if (offset2 < (m->width * m->height) &&
-                        !m->cells[offset2].transparent)
+                        !tile_view_is_transparent(v, x2, y2))
                     {
-                        m->cells[offset2].fov = true;
+                        m->fov[offset2] = true;
                     }
                 }
             }
@@ -204,7 +187,11 @@ void fov_map_postprocess_quad(rg_fov_map *m,
     }
 }
 
-void fov_map_postprocess(rg_fov_map *m, int pov_x, int pov_y, int radius)
+void fov_map_postprocess(rg_fov_map *m,
+                         const rg_tile_view *v,
+                         int pov_x,
+                         int pov_y,
+                         int radius)
 {
     int x_min = 0;
     int y_min = 0;
@@ -217,13 +204,14 @@ void fov_map_postprocess(rg_fov_map *m, int pov_x, int pov_y, int radius)
         x_max = MIN(x_max, pov_x + radius + 1);
         y_max = MIN(y_max, pov_y + radius + 1);
     }
-    fov_map_postprocess_quad(m, x_min, y_min, pov_x, pov_y, -1, -1);
-    fov_map_postprocess_quad(m, pov_x, y_min, x_max - 1, pov_y, 1, -1);
-    fov_map_postprocess_quad(m, x_min, pov_y, pov_x, y_max - 1, -1, 1);
-    fov_map_postprocess_quad(m, pov_x, pov_y, x_max - 1, y_max - 1, 1, 1);
+    fov_map_postprocess_quad(m, v, x_min, y_min, pov_x, pov_y, -1, -1);
+    fov_map_postprocess_quad(m, v, pov_x, y_min, x_max - 1, pov_y, 1, -1);
+    fov_map_postprocess_quad(m, v, x_min, pov_y, pov_x, y_max - 1, -1, 1);
+    fov_map_postprocess_quad(m, v, pov_x, pov_y, x_max - 1, y_max - 1, 1, 1);
 }
 
 void fov_map_compute(rg_fov_map *m,
+                     const rg_tile_view *v,
                      int pov_x,
                      int pov_y,
                      int max_radius,
@@ -231,7 +219,8 @@ void fov_map_compute(rg_fov_map *m,
 {
     if (m == NULL) return;
     if (!fov_map_in_bounds(m, pov_x, pov_y)) return;
-    for (int i = 0; i < m->width * m->height; i++) m->cells[i].fov = false;
+    ASSERT_M(v->map->width == m->width && v->map->height == m->height);
+    memset(m->fov, 0, sizeof(*m->fov) * m->width * m->height);
 
     int x_min = 0;
     int y_min = 0;
@@ -247,31 +236,31 @@ void fov_map_compute(rg_fov_map *m,
 
     int idx = pov_x + pov_y * m->width;
 
-    m->cells[idx].fov = true;
+    m->fov[idx] = true;
     // Cast rays along the perimeter.
     const int radius_squared = max_radius * max_radius;
     for (int x = x_min; x < x_max; ++x)
     {
         fov_map_cast_ray(
-          m, pov_x, pov_y, x, y_min, radius_squared, light_walls);
+          m, v, pov_x, pov_y, x, y_min, radius_squared, light_walls);
     }
     for (int y = y_min + 1; y < y_max; ++y)
     {
         fov_map_cast_ray(
-          m, pov_x, pov_y, x_max - 1, y, radius_squared, light_walls);
+          m, v, pov_x, pov_y, x_max - 1, y, radius_squared, light_walls);
     }
     for (int x = x_max - 2; x >= x_min; --x)
     {
         fov_map_cast_ray(
-          m, pov_x, pov_y, x, y_max - 1, radius_squared, light_walls);
+          m, v, pov_x, pov_y, x, y_max - 1, radius_squared, light_walls);
     }
     for (int y = y_max - 2; y > y_min; --y)
     {
         fov_map_cast_ray(
-          m, pov_x, pov_y, x_min, y, radius_squared, light_walls);
+          m, v, pov_x, pov_y, x_min, y, radius_squared, light_walls);
     }
     if (light_walls)
     {
-        fov_map_postprocess(m, pov_x, pov_y, max_radius);
+        fov_map_postprocess(m, v, pov_x, pov_y, max_radius);
     }
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#include "game_map.h"
+
 typedef struct rg_line_data
 {
     int step_x, step_y;
@@ -12,18 +14,12 @@ typedef struct rg_line_data
     int dest_x, dest_y;
 } rg_line_data;
 
-typedef struct rg_fov_map_cell
-{
-    bool transparent;
-    bool walkable;
-    bool fov;
-} rg_fov_map_cell;
-
+// Only holds the result, transparency is read from the map through a view.
 typedef struct rg_fov_map
 {
     int width;
     int height;
-    rg_fov_map_cell *cells;
+    bool *fov;
 } rg_fov_map;
 
 void line_init(int x0, int y0, int x1, int y1, rg_line_data *data);
@@ -32,14 +28,9 @@ void fov_map_create(rg_fov_map *m, int w, int h);
 void fov_map_destroy(rg_fov_map *m);
 bool fov_map_in_bounds(rg_fov_map *m, int x, int y);
 bool fov_map_is_in_fov(rg_fov_map *m, int x, int y);
-bool fov_map_is_walkable(rg_fov_map *m, int x, int y);
 
-void fov_map_set_props(rg_fov_map *m,
-                       int x,
-                       int y,
-                       bool transparent,
-                       bool walkable);
 void fov_map_cast_ray(rg_fov_map *m,
+                      const rg_tile_view *v,
                       int orig_x,
                       int orig_y,
                       int dest_x,
@@ -47,6 +38,7 @@ void fov_map_cast_ray(rg_fov_map *m,
                       int radius_squared,
                       bool light_walls);
 void fov_map_postprocess_quad(rg_fov_map *m,
+                              const rg_tile_view *v,
                               int x0,
                               int y0,
                               int x1,
@@ -54,8 +46,13 @@ void fov_map_postprocess_quad(rg_fov_map *m,
                               int dx,
                               int dy);
 
-void fov_map_postprocess(rg_fov_map *m, int pov_x, int pov_y, int radius);
+void fov_map_postprocess(rg_fov_map *m,
+                         const rg_tile_view *v,
+                         int pov_x,
+                         int pov_y,
+                         int radius);
 void fov_map_compute(rg_fov_map *m,
+                     const rg_tile_view *v,
                      int pov_x,
                      int pov_y,
                      int max_radius,
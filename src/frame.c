@@ -0,0 +1,180 @@
+#include "frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "panic.h"
+#include "types.h"
+
+#define FRAME_FRESH 4 // set in `shared` while the middle frame is unread
+#define FRAME_INDEX 3
+
+void frame_create(rg_frame* f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+void frame_destroy(rg_frame* f)
+{
+    for (int i = 0; i < FRAME_LAYER_LEN; i++) free(f->layers[i].cells);
+    memset(f, 0, sizeof(*f));
+}
+
+// Copies the console's cells into the layer and shows it at x, y.
+void frame_capture(rg_frame* f,
+                   rg_frame_layer_id id,
+                   const rg_console* c,
+                   int x,
+                   int y)
+{
+    rg_frame_layer* l = &f->layers[id];
+    const int len = c->width * c->height;
+    if (l->cells == NULL || l->width * l->height < len)
+    {
+        free(l->cells);
+        l->cells = malloc(sizeof(*l->cells) * len);
+        ASSERT_M(l->cells != NULL);
+    }
+    memcpy(l->cells, c->cells, sizeof(*l->cells) * len);
+    l->visible = true;
+    l->x = x;
+    l->y = y;
+    l->width = c->width;
+    l->height = c->height;
+    l->backdrop = (SDL_Rect){ 0 };
+    l->outline = (SDL_Rect){ 0 };
+}
+
+void frame_buffer_create(rg_frame_buffer* b)
+{
+    for (int i = 0; i < 3; i++) frame_create(&b->frames[i]);
+    b->back = 0;
+    SDL_AtomicSet(&b->shared, 1);
+    b->front = 2;
+}
+
+void frame_buffer_destroy(rg_frame_buffer* b)
+{
+    for (int i = 0; i < 3; i++) frame_destroy(&b->frames[i]);
+}
+
+rg_frame* frame_buffer_back(rg_frame_buffer* b)
+{
+    return &b->frames[b->back];
+}
+
+// Hands the back frame over, the producer gets the middle one to write next.
+void frame_buffer_publish(rg_frame_buffer* b)
+{
+    const int old = SDL_AtomicSet(&b->shared, b->back | FRAME_FRESH);
+    b->back = old & FRAME_INDEX;
+}
+
+// The newest published frame, NULL if there was none since the last take.
+// The frame stays valid until the next take.
+rg_frame* frame_buffer_take(rg_frame_buffer* b)
+{
+    if ((SDL_AtomicGet(&b->shared) & FRAME_FRESH) == 0) return NULL;
+    const int old = SDL_AtomicSet(&b->shared, b->front);
+    b->front = old & FRAME_INDEX;
+    return &b->frames[b->front];
+}
+
+void frame_view_create(rg_frame_view* v,
+                       SDL_Renderer* renderer,
+                       rg_tileset* tileset,
+                       int width,
+                       int height)
+{
+    memset(v, 0, sizeof(*v));
+    v->renderer = renderer;
+    v->tileset = tileset;
+    v->width = width;
+    v->height = height;
+}
+
+void frame_view_destroy(rg_frame_view* v)
+{
+    for (int i = 0; i < FRAME_LAYER_LEN; i++)
+    {
+        if (v->consoles[i].width > 0) console_destroy(&v->consoles[i]);
+    }
+    if (v->page != NULL) SDL_DestroyTexture(v->page);
+    memset(v, 0, sizeof(*v));
+}
+
+// One slot of the page per layer, stacked top to bottom, each big enough for
+// a console covering the whole screen.
+static void frame_view_create_page(rg_frame_view* v)
+{
+    const int ts = v->tileset->tile_size;
+    v->page = SDL_CreateTexture(v->renderer,
+                                SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_TARGET,
+                                v->width * ts,
+                                v->height * ts * FRAME_LAYER_LEN);
+    if (v->page == NULL) panic("failed to create the console page");
+    SDL_SetTextureBlendMode(v->page, SDL_BLENDMODE_BLEND);
+}
+
+static rg_console* frame_view_console(rg_frame_view* v,
+                                      const rg_frame_layer* l,
+                                      int id)
+{
+    rg_console* c = &v->consoles[id];
+    if (c->width == l->width && c->height == l->height) return c;
+    ASSERT_M(l->width <= v->width && l->height <= v->height);
+    if (c->width > 0) console_destroy(c);
+    console_create(c, v->renderer, l->width, l->height, v->tileset);
+    console_attach(c, v->page, 0, id * v->height * v->tileset->tile_size);
+    return c;
+}
+
+// Repaints the changed cells of every visible layer in one pass over the
+// page, then composites the layers bottom to top. Layers that didn't change
+// are only copied, an overlay showing up doesn't repaint what is under it.
+void frame_view_render(rg_frame_view* v, const rg_frame* f)
+{
+    if (v->page == NULL) frame_view_create_page(v);
+
+    bool paint[FRAME_LAYER_LEN] = { false };
+    bool any = false;
+    for (int i = 0; i < FRAME_LAYER_LEN; i++)
+    {
+        const rg_frame_layer* l = &f->layers[i];
+        if (!l->visible) continue;
+        rg_console* c = frame_view_console(v, l, i);
+        memcpy(c->cells, l->cells, sizeof(*c->cells) * l->width * l->height);
+        paint[i] = console_prepare(c);
+        any |= paint[i];
+    }
+    if (any)
+    {
+        SDL_SetRenderTarget(v->renderer, v->page);
+        for (int i = 0; i < FRAME_LAYER_LEN; i++)
+        {
+            if (paint[i]) console_paint(&v->consoles[i]);
+        }
+        SDL_SetRenderTarget(v->renderer, NULL);
+    }
+
+    SDL_SetRenderDrawColor(v->renderer, 0, 0, 0, 255);
+    SDL_RenderClear(v->renderer);
+    for (int i = 0; i < FRAME_LAYER_LEN; i++)
+    {
+        const rg_frame_layer* l = &f->layers[i];
+        if (!l->visible) continue;
+        if (l->backdrop.w > 0)
+        {
+            SDL_SetRenderDrawColor(v->renderer, 0, 0, 0, 255);
+            SDL_RenderFillRect(v->renderer, &l->backdrop);
+        }
+        if (l->outline.w > 0)
+        {
+            SDL_SetRenderDrawColor(v->renderer, 255, 255, 255, 255);
+            SDL_RenderDrawRect(v->renderer, &l->outline);
+        }
+        console_flush(&v->consoles[i], l->x, l->y);
+    }
+    SDL_RenderPresent(v->renderer);
+}
@@ -0,0 +1,88 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "console.h"
+
+// Consoles of the game screen, bottom to top.
+typedef enum rg_frame_layer_id
+{
+    FRAME_LAYER_WORLD,
+    FRAME_LAYER_PANEL,
+    FRAME_LAYER_MENU,
+
+    FRAME_LAYER_LEN,
+} rg_frame_layer_id;
+
+// A copy of a console's cells and where they go on screen.
+typedef struct rg_frame_layer
+{
+    bool visible;
+    int x; // in cells
+    int y;
+    int width;
+    int height;
+    rg_console_cell* cells;
+    SDL_Rect backdrop; // in pixels, filled black under the console
+    SDL_Rect outline;  // in pixels, drawn white under the console
+} rg_frame_layer;
+
+// Everything needed to draw the game screen once, without touching the game
+// state it was made from.
+typedef struct rg_frame
+{
+    bool ended; // the game left the play screen
+    rg_frame_layer layers[FRAME_LAYER_LEN];
+} rg_frame;
+
+void frame_create(rg_frame* f);
+void frame_destroy(rg_frame* f);
+void frame_capture(rg_frame* f,
+                   rg_frame_layer_id id,
+                   const rg_console* c,
+                   int x,
+                   int y);
+
+// Three frames passed from one producer to one consumer without locks. The
+// producer always has a frame to write and the consumer always has the
+// newest complete one, frames the consumer didn't get to are skipped.
+typedef struct rg_frame_buffer
+{
+    rg_frame frames[3];
+    SDL_atomic_t shared; // index of the middle frame, FRAME_FRESH if unread
+    int back;            // written by the producer
+    int front;           // read by the consumer
+} rg_frame_buffer;
+
+void frame_buffer_create(rg_frame_buffer* b);
+void frame_buffer_destroy(rg_frame_buffer* b);
+rg_frame* frame_buffer_back(rg_frame_buffer* b);
+void frame_buffer_publish(rg_frame_buffer* b);
+rg_frame* frame_buffer_take(rg_frame_buffer* b);
+
+// The consoles frames are rendered with, they keep what they showed last so
+// only changed cells are repainted. All of them draw into their own slot of
+// one page texture, so painting them takes a single render target switch and
+// compositing copies from a single texture.
+typedef struct rg_frame_view
+{
+    SDL_Renderer* renderer;
+    rg_tileset* tileset;
+    int width; // of the screen, in cells
+    int height;
+    SDL_Texture* page;                    // NULL until the first render
+    rg_console consoles[FRAME_LAYER_LEN]; // width 0 until first used
+} rg_frame_view;
+
+void frame_view_create(rg_frame_view* v,
+                       SDL_Renderer* renderer,
+                       rg_tileset* tileset,
+                       int width,
+                       int height);
+void frame_view_destroy(rg_frame_view* v);
+void frame_view_render(rg_frame_view* v, const rg_frame* f);
+
+#endif
@@ -1,474 +1,393 @@
 #include "game_map.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "array.h"
 #include "color.h"
+#include "panic.h"
 #include "types.h"
 
-typedef struct room_array
-{
-    size_t len;
-    size_t capacity;
-    SDL_Rect *data;
-} room_array;
-
-void map_create(rg_map *m,
-                int width,
-                int height,
-                int level,
-                int room_min_size,
-                int room_max_size,
-                int max_rooms,
-                int max_monsters_per_room,
-                int max_items_per_room,
-                rg_entity_array *entities,
-                rg_items *items,
-                rg_entity_id player)
+void map_alloc(rg_map *m, int width, int height, int level)
 {
     memset(m, 0, sizeof(rg_map));
     m->width = width;
     m->height = height;
     m->level = level;
-    m->tiles.capacity = m->width * m->height;
-    m->tiles.data = malloc(sizeof(m->tiles.data) * m->tiles.capacity);
-    m->tiles.len = m->tiles.capacity;
-    ASSERT_M(m->tiles.data != NULL);
-
-    for (int y = 0; y < m->height; y++)
-    {
-        for (int x = 0; x < m->width; x++)
-        {
-            map_set_tile(m, x, y, (rg_tile){ true, true });
-        }
-    }
-
-    room_array rooms = { .capacity = max_rooms,
-                         .len = 0,
-                         .data = malloc(sizeof(SDL_Rect) * max_rooms) };
-    int num_rooms = 0;
-
-    for (int r = 0; r < max_rooms; r++)
-    {
-        int w = RAND_INT(room_min_size, room_max_size);
-        int h = RAND_INT(room_min_size, room_max_size);
-        int x = RAND_INT(0, m->width - w - 1);
-        int y = RAND_INT(0, m->height - h - 1);
-
-        SDL_Rect new_room = { .x = x, .y = y, .w = w, .h = h };
-        bool intersects = false;
-        for (int i = 0; i < rooms.len; i++)
-        {
-            if (room_intersects(&new_room, &rooms.data[i]))
-            {
-                intersects = true;
-                break;
-            }
-        }
-        if (intersects) continue;
-
-        map_create_room(m, new_room);
-        int new_x, new_y;
-        room_get_center(&new_room, &new_x, &new_y);
-        if (rooms.len == 0)
-        {
-            entities->data[player].x = new_x;
-            entities->data[player].y = new_y;
-        }
-        else
-        {
-            int prev_x, prev_y;
-            room_get_center(&rooms.data[rooms.len - 1], &prev_x, &prev_y);
-            if (RAND_INT(0, 1) == 1)
-            {
-                map_create_h_tunnel(m, prev_x, new_x, prev_y);
-                map_create_v_tunnel(m, prev_y, new_y, new_x);
-            }
-            else
-            {
-                map_create_v_tunnel(m, prev_y, new_y, prev_x);
-                map_create_h_tunnel(m, prev_x, new_x, new_y);
-            }
-            map_place_entities(m,
-                               &new_room,
-                               entities,
-                               max_monsters_per_room,
-                               items,
-                               max_items_per_room);
-        }
-
-        memcpy(&rooms.data[rooms.len], &new_room, sizeof(SDL_Rect));
-        rooms.len++;
-    }
-
-    // Stairs
-    SDL_Rect last_room = rooms.data[rooms.len - 1];
-    ARRAY_PUSH(entities,
-               ((rg_entity){
-                 .x = last_room.x + last_room.w / 2,
-                 .y = last_room.y + last_room.h / 2,
-                 .ch = '>',
-                 .color = WHITE,
-                 .name = "Stairs",
-                 .blocks = false,
-                 .type = ENTITY_STAIRS,
-                 .render_order = RENDER_ORDER_STAIRS,
-               }));
-    free(rooms.data);
+    m->chunks_wide = (width + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+    m->chunks_high = (height + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+    const int len = m->chunks_wide * m->chunks_high;
+    m->chunks = calloc(len, sizeof(*m->chunks));
+    m->built = calloc(len, sizeof(*m->built));
+    m->cache_slots = malloc(sizeof(*m->cache_slots) * len);
+    ASSERT_M(m->chunks != NULL && m->built != NULL && m->cache_slots != NULL);
+    for (int i = 0; i < len; i++)
+        m->cache_slots[i] = (rg_map_cache_slot){ .offset = -1 };
 }
 
 void map_destroy(rg_map *m)
 {
-    free(m->tiles.data);
+    if (m->chunks != NULL)
+    {
+        for (int i = 0; i < m->chunks_wide * m->chunks_high; i++)
+            free(m->chunks[i]);
+    }
+    free(m->chunks);
+    free(m->built);
+    free(m->cache_slots);
+    free(m->cache_buf.data);
+    if (m->cache != NULL) fclose(m->cache);
+    memset(m, 0, sizeof(*m));
 }
 
-rg_tile *map_get_tile(rg_map *m, int x, int y)
+static const struct
 {
-    size_t idx = x + m->width * y;
-    ASSERT_M(idx < m->tiles.capacity);
-    return &m->tiles.data[idx];
+    bool blocked;
+    bool block_sight;
+} tile_props[TILE_TYPE_LEN] = {
+    [TILE_WALL] = { .blocked = true, .block_sight = true },
+    [TILE_FLOOR] = { .blocked = false, .block_sight = false },
+    [TILE_DOOR_CLOSED] = { .blocked = true, .block_sight = true },
+    [TILE_DOOR_OPEN] = { .blocked = false, .block_sight = false },
+};
+
+// The chunk holding (x, y), fetched when it isn't resident.
+static rg_map_chunk *map_chunk_at(rg_map *m, int x, int y)
+{
+    return map_chunk_fetch(m, x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
 }
 
-void map_set_tile(rg_map *m, int x, int y, rg_tile tile)
+// Mask of chunk columns [x0, x1), both relative to the chunk.
+static uint64_t chunk_span(int x0, int x1)
 {
-    size_t idx = x + m->width * y;
-    ASSERT_M(idx < m->tiles.capacity);
-    m->tiles.data[idx] = tile;
+    uint64_t mask = ~0ull << x0;
+    if (x1 < MAP_CHUNK_SIZE) mask &= (1ull << x1) - 1;
+    return mask;
 }
 
-bool map_is_blocked(rg_map *m, int x, int y)
+static void chunk_carve(rg_map_chunk *c, int y, int x0, int x1)
 {
-    return x < 0 || x >= m->width || y < 0 || y >= m->height ||
-           map_get_tile(m, x, y)->blocked;
+    const uint64_t mask = chunk_span(x0, x1);
+    c->planes[MAP_PLANE_BLOCKED][y] &= ~mask;
+    c->planes[MAP_PLANE_BLOCK_SIGHT][y] &= ~mask;
+    memset(&c->types[x0 + y * MAP_CHUNK_SIZE], TILE_FLOOR, x1 - x0);
 }
 
-void map_create_room(rg_map *m, SDL_Rect room)
+static void chunk_fill_rock(rg_map_chunk *c)
 {
-    int x1 = room.x;
-    int x2 = room.x + room.w;
-    int y1 = room.y;
-    int y2 = room.y + room.h;
-    for (int x = x1 + 1; x < x2; x++)
+    for (int y = 0; y < MAP_CHUNK_SIZE; y++)
     {
-        for (int y = y1 + 1; y < y2; y++)
-        {
-            map_get_tile(m, x, y)->blocked = false;
-            map_get_tile(m, x, y)->block_sight = false;
-        }
+        c->planes[MAP_PLANE_BLOCKED][y] = ~0ull;
+        c->planes[MAP_PLANE_BLOCK_SIGHT][y] = ~0ull;
+        c->planes[MAP_PLANE_EXPLORED][y] = 0;
     }
+    memset(c->types, TILE_WALL, sizeof(c->types));
 }
 
-void map_create_h_tunnel(rg_map *m, int x1, int x2, int y)
+// Writes the chunk to the cache file, run length encoded, and frees it. A
+// chunk evicted before is rewritten in place when it still fits. The chunk
+// stays resident when writing fails. Chunks that were never generated are
+// only rock and are dropped.
+static bool chunk_evict(rg_map *m, int idx)
 {
-    for (int x = MIN(x1, x2); x < MAX(x1, x2) + 1; x++)
+    if (!m->built[idx])
+    {
+        free(m->chunks[idx]);
+        m->chunks[idx] = NULL;
+        return true;
+    }
+    if (m->cache == NULL)
+    {
+        m->cache = tmpfile();
+        if (m->cache == NULL) return false;
+    }
+    rg_bytes *buf = &m->cache_buf;
+    if (buf->capacity == 0)
     {
-        map_get_tile(m, x, y)->blocked = false;
-        map_get_tile(m, x, y)->block_sight = false;
+        buf->capacity = 256;
+        buf->data = malloc(buf->capacity);
+        ASSERT_M(buf->data != NULL);
     }
+    buf->len = 0;
+    rle_encode(buf, (const uint8_t *)m->chunks[idx], sizeof(rg_map_chunk));
+
+    rg_map_cache_slot *slot = &m->cache_slots[idx];
+    const long len = (long)buf->len;
+    const bool fits = slot->offset != -1 && len <= slot->room;
+    const long offset = fits ? slot->offset : m->cache_len;
+    if (fseek(m->cache, offset, SEEK_SET) != 0 ||
+        fwrite(buf->data, 1, buf->len, m->cache) != buf->len)
+        return false;
+    if (!fits)
+    {
+        slot->offset = offset;
+        slot->room = len;
+        m->cache_len += len;
+    }
+    slot->len = len;
+    free(m->chunks[idx]);
+    m->chunks[idx] = NULL;
+    return true;
 }
 
-void map_create_v_tunnel(rg_map *m, int y1, int y2, int x)
+// Reads an evicted chunk back from the cache file into `c`.
+static void chunk_read(rg_map *m, int idx, rg_map_chunk *c)
 {
-    for (int y = MIN(y1, y2); y < MAX(y1, y2) + 1; y++)
+    const rg_map_cache_slot *slot = &m->cache_slots[idx];
+    rg_bytes *buf = &m->cache_buf;
+    if ((size_t)slot->len > buf->capacity)
     {
-        map_get_tile(m, x, y)->blocked = false;
-        map_get_tile(m, x, y)->block_sight = false;
+        buf->capacity = slot->len;
+        buf->data = realloc(buf->data, buf->capacity);
+        ASSERT_M(buf->data != NULL);
     }
+    buf->len = slot->len;
+    if (fseek(m->cache, slot->offset, SEEK_SET) != 0 ||
+        fread(buf->data, 1, buf->len, m->cache) != buf->len)
+        panic("failed to read a map chunk back from the cache");
+    rle_decode(buf, 0, (uint8_t *)c, sizeof(*c));
 }
 
-static int val_from_dungeon_level(int current_level,
-                                  int len,
-                                  int *levels,
-                                  int *values)
+// Makes a chunk resident, reading it back from the cache. A chunk that was
+// never generated comes out as rock.
+rg_map_chunk *map_chunk_fetch(rg_map *m, int cx, int cy)
 {
-    for (int i = len - 1; i >= 0; i--)
-    {
-        if (current_level >= levels[i]) return values[i];
-    }
-    return 0;
+    ASSERT_M(cx >= 0 && cx < m->chunks_wide && cy >= 0 && cy < m->chunks_high);
+    const int idx = cx + cy * m->chunks_wide;
+    if (m->chunks[idx] != NULL) return m->chunks[idx];
+
+    rg_map_chunk *c = malloc(sizeof(*c));
+    ASSERT_M(c != NULL);
+    if (m->cache_slots[idx].offset != -1)
+        chunk_read(m, idx, c);
+    else
+        chunk_fill_rock(c);
+    m->chunks[idx] = c;
+    return c;
 }
 
-void map_place_entities(rg_map *m,
-                        SDL_Rect *room,
-                        rg_entity_array *entities,
-                        int max_monsters_per_room,
-                        rg_items *items,
-                        int max_items_per_room)
+// Reads a chunk without making it resident: the resident chunk if there is
+// one, otherwise a copy in `scratch`. For walking every chunk, e.g. to save
+// the map, without bringing them all into memory.
+const rg_map_chunk *map_chunk_peek(rg_map *m,
+                                   int cx,
+                                   int cy,
+                                   rg_map_chunk *scratch)
 {
+    ASSERT_M(cx >= 0 && cx < m->chunks_wide && cy >= 0 && cy < m->chunks_high);
+    const int idx = cx + cy * m->chunks_wide;
+    if (m->chunks[idx] != NULL) return m->chunks[idx];
+    if (m->cache_slots[idx].offset != -1)
+        chunk_read(m, idx, scratch);
+    else
+        chunk_fill_rock(scratch);
+    return scratch;
+}
+
+// Marks a chunk as generated and returns it resident and solid, for the
+// generator to carve or a loader to fill in.
+rg_map_chunk *map_chunk_build(rg_map *m, int cx, int cy)
+{
+    ASSERT_M(!map_chunk_is_built(m, cx, cy));
+    rg_map_chunk *c = map_chunk_fetch(m, cx, cy);
+    chunk_fill_rock(c);
+    m->built[cx + cy * m->chunks_wide] = true;
+    return c;
+}
 
-    int num_monsters = RAND_INT(0, max_monsters_per_room);
+// Makes every chunk overlapping `area`, in cells, resident.
+void map_fetch_area(rg_map *m, const SDL_Rect *area)
+{
+    const SDL_Rect map = { .x = 0, .y = 0, .w = m->width, .h = m->height };
+    SDL_Rect r;
+    if (!SDL_IntersectRect(area, &map, &r)) return;
+    const int cx1 = (r.x + r.w - 1) >> MAP_CHUNK_SHIFT;
+    const int cy1 = (r.y + r.h - 1) >> MAP_CHUNK_SHIFT;
+    for (int cy = r.y >> MAP_CHUNK_SHIFT; cy <= cy1; cy++)
     {
-        int levels[] = { 1, 4, 6 };
-        int vals[] = { 2, 3, 5 };
-        num_monsters = val_from_dungeon_level(m->level, 3, levels, vals);
+        for (int cx = r.x >> MAP_CHUNK_SHIFT; cx <= cx1; cx++)
+            map_chunk_fetch(m, cx, cy);
     }
-    for (int i = 0; i < num_monsters; i++)
-    {
-        // FIXME: bug in random max limit???
-        int x = RAND_INT(room->x + 1, room->x + room->w - 3);
-        int y = RAND_INT(room->y + 1, room->y + room->h - 3);
+}
 
-        ASSERT_M(x != room->x && x != room->x + room->w);
-        ASSERT_M(y != room->y && y != room->y + room->h);
+// True once a chunk was generated, whether it is resident or cached.
+bool map_chunk_is_built(const rg_map *m, int cx, int cy)
+{
+    return m->built[cx + cy * m->chunks_wide];
+}
 
-        bool valid = true;
-        for (int m = 0; m < entities->len; m++)
+// Evicts the resident chunks that are far away from (x, y) and fetches the
+// ones around it, so everything the player can see or reach this turn is
+// resident for the fast accessors.
+void map_stream(rg_map *m, int x, int y)
+{
+    const int pcx = x >> MAP_CHUNK_SHIFT;
+    const int pcy = y >> MAP_CHUNK_SHIFT;
+    for (int cy = 0; cy < m->chunks_high; cy++)
+    {
+        for (int cx = 0; cx < m->chunks_wide; cx++)
         {
-            rg_entity *e = &entities->data[m];
-            if (e->x == x && e->y == y)
-            {
-                valid = false;
-                break;
-            }
+            const int idx = cx + cy * m->chunks_wide;
+            if (m->chunks[idx] == NULL) continue;
+            if (abs(cx - pcx) <= MAP_CHUNK_KEEP &&
+                abs(cy - pcy) <= MAP_CHUNK_KEEP)
+                continue;
+            if (!chunk_evict(m, idx)) break;
         }
+    }
+    const int keep = MAP_CHUNK_KEEP << MAP_CHUNK_SHIFT;
+    const SDL_Rect near = { .x = (pcx << MAP_CHUNK_SHIFT) - keep,
+                            .y = (pcy << MAP_CHUNK_SHIFT) - keep,
+                            .w = 2 * keep + MAP_CHUNK_SIZE,
+                            .h = 2 * keep + MAP_CHUNK_SIZE };
+    map_fetch_area(m, &near);
+}
 
-        if (!valid) continue;
-
-        int troll_chances = 0;
-        {
-            int levels[] = { 3, 5, 7 };
-            int vals[] = { 15, 30, 60 };
-            troll_chances = val_from_dungeon_level(m->level, 3, levels, vals);
-        }
+bool map_get(rg_map *m, rg_map_plane plane, int x, int y)
+{
+    ASSERT_M(plane < MAP_PLANE_LEN);
+    ASSERT_M(x >= 0 && x < m->width && y >= 0 && y < m->height);
+    return map_chunk_get(map_chunk_at(m, x, y), plane, x, y);
+}
 
-        int monster_chances[] = { 80, troll_chances };
-        int midx = rand_int_choice_index(MONSTER_LEN, monster_chances);
-        ASSERT_M(midx >= 0);
-        ASSERT_M(midx < MONSTER_LEN);
-        switch (midx)
-        {
-        case MONSTER_ORC:
-        {
-            rg_fighter fighter = {
-                .hp = 20, .defence = 0, .power = 4, .xp = 35
-            };
-            ARRAY_PUSH(entities,
-                       ((rg_entity){
-                         .x = x,
-                         .y = y,
-                         .ch = 'o',
-                         .color = GREEN,
-                         .name = "Orc",
-                         .blocks = true,
-                         .type = ENTITY_BASIC_MONSTER,
-                         .fighter = fighter,
-                         .state.type = ENTITY_STATE_FOLLOW_PLAYER,
-                         .render_order = RENDER_ORDER_ACTOR,
-                       }));
-            break;
-        }
-        case MONSTER_TROLL:
-        {
-            rg_fighter fighter = {
-                .hp = 30, .defence = 2, .power = 8, .xp = 100
-            };
-            ARRAY_PUSH(entities,
-                       ((rg_entity){
-                         .x = x,
-                         .y = y,
-                         .ch = 'T',
-                         .color = DARKER_GREEN,
-                         .name = "Troll",
-                         .blocks = true,
-                         .type = ENTITY_BASIC_MONSTER,
-                         .fighter = fighter,
-                         .state.type = ENTITY_STATE_FOLLOW_PLAYER,
-                         .render_order = RENDER_ORDER_ACTOR,
-                       }));
-            break;
-        }
-        default:
-            ASSERT_M(false); // invalid option
-            break;
-        }
-    }
-    int num_items = RAND_INT(0, max_items_per_room);
-    {
-        int levels[] = { 1, 4 };
-        int vals[] = { 1, 2 };
-        num_items = val_from_dungeon_level(m->level, 2, levels, vals);
-    }
-    for (int i = 0; i < num_items; i++)
-    {
-        int x = RAND_INT(room->x + 1, room->x + room->w - 3);
-        int y = RAND_INT(room->y + 1, room->y + room->h - 3);
+void map_set(rg_map *m, rg_map_plane plane, int x, int y, bool value)
+{
+    ASSERT_M(plane < MAP_PLANE_LEN);
+    ASSERT_M(x >= 0 && x < m->width && y >= 0 && y < m->height);
+    map_chunk_set(map_chunk_at(m, x, y), plane, x, y, value);
+}
 
-        ASSERT_M(x != room->x && x != room->x + room->w);
-        ASSERT_M(y != room->y && y != room->y + room->h);
+bool map_is_blocked(rg_map *m, int x, int y)
+{
+    return x < 0 || x >= m->width || y < 0 || y >= m->height ||
+           map_chunk_get(map_chunk_at(m, x, y), MAP_PLANE_BLOCKED, x, y);
+}
 
-        bool valid = true;
-        for (int m = 0; m < entities->len; m++)
-        {
-            rg_entity *e = &entities->data[m];
-            if (e->x == x && e->y == y)
-            {
-                valid = false;
-                break;
-            }
-        }
+rg_tile_type map_get_type(rg_map *m, int x, int y)
+{
+    ASSERT_M(x >= 0 && x < m->width && y >= 0 && y < m->height);
+    return map_chunk_type(map_chunk_at(m, x, y), x, y);
+}
 
-        if (!valid) continue;
+// Changes the terrain of a cell and records it for the derived structures,
+// which repair what lies around the changed cells instead of rebuilding.
+void map_set_tile(rg_map *m, int x, int y, rg_tile_type type)
+{
+    ASSERT_M(type < TILE_TYPE_LEN);
+    ASSERT_M(x >= 0 && x < m->width && y >= 0 && y < m->height);
+    rg_map_chunk *c = map_chunk_at(m, x, y);
+    uint8_t *cell = &c->types[(x & MAP_CHUNK_MASK) +
+                              (y & MAP_CHUNK_MASK) * MAP_CHUNK_SIZE];
+    if (*cell == type) return;
+    *cell = (uint8_t)type;
+    map_chunk_set(c, MAP_PLANE_BLOCKED, x, y, tile_props[type].blocked);
+    map_chunk_set(c, MAP_PLANE_BLOCK_SIGHT, x, y, tile_props[type].block_sight);
+
+    m->changes[m->generation % MAP_CHANGE_LOG_LEN] =
+      (SDL_Point){ .x = x, .y = y };
+    m->generation++;
+}
 
-        int item_chances[6] = { 0 };
-        item_chances[0] = 35;
-        {
-            int levels[] = { 4 };
-            int vals[] = { 25 };
-            item_chances[1] = val_from_dungeon_level(m->level, 1, levels, vals);
-        }
-        {
-            int levels[] = { 6 };
-            int vals[] = { 25 };
-            item_chances[2] = val_from_dungeon_level(m->level, 1, levels, vals);
-        }
-        {
-            int levels[] = { 2 };
-            int vals[] = { 10 };
-            item_chances[3] = val_from_dungeon_level(m->level, 1, levels, vals);
-        }
-        {
-            int levels[] = { 4 };
-            int vals[] = { 5 };
-            item_chances[4] = val_from_dungeon_level(m->level, 1, levels, vals);
-        }
-        {
-            int levels[] = { 8 };
-            int vals[] = { 15 };
-            item_chances[5] = val_from_dungeon_level(m->level, 1, levels, vals);
-        }
-        int idx = rand_int_choice_index(ITEM_LEN - 1, item_chances);
-        ASSERT_M(idx >= 0);
-        ASSERT_M(idx < ITEM_LEN - 1);
-        // int item_chance = RAND_INT(0, 100);
-        switch (idx)
-        {
-        case ITEM_POTION_HEAL:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '!',
-                         .color = LIGHTEST_VIOLET,
-                         .name = "Healing Potion",
-                         .type = ITEM_POTION_HEAL,
-                         .heal = { .amount = 40 },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        case ITEM_FIRE_BALL:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '*',
-                         .color = FLAME,
-                         .name = "Fireball Scroll",
-                         .type = ITEM_FIRE_BALL,
-                         .fireball = {
-                             .damage = 25,
-                             .radius = 3,
-                             .targeting_msg = "Left-click a target tile for the fireball, or right-click to cancel.",
-                             .targeting_msg_color = CYAN,
-                             },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        case ITEM_CAST_CONFUSE:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '#',
-                         .color = LIGHT_PINK,
-                         .name = "Confusion Scroll",
-                         .type = ITEM_CAST_CONFUSE,
-                         .confuse = {
-                             .duration = 10,
-                             .targeting_msg = "Left-click an enemy to confuse it, or right-click to cancel.",
-                             .targeting_msg_color = CYAN,
-                             },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        case ITEM_LIGHTNING:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '#',
-                         .color = YELLOW,
-                         .name = "Lightning Scroll",
-                         .type = ITEM_LIGHTNING,
-                         .lightning = {
-                             .damage = 40,
-                             .maximum_range = 5,
-                             },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        case ITEM_SWORD:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '/',
-                         .color = SKY,
-                         .name = "Sword",
-                         .type = ITEM_EQUIPMENT,
-                         .equipable = { .slot = EQUIPMENT_SLOT_MAIN_HAND,
-                                        .power_bonus = 3 },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        case ITEM_SHIELD:
-        {
-            ARRAY_PUSH(items,
-                       ((rg_item){
-                         .x = x,
-                         .y = y,
-                         .ch = '[',
-                         .color = DARKER_ORANGE,
-                         .name = "Shield",
-                         .type = ITEM_EQUIPMENT,
-                         .equipable = { .slot = EQUIPMENT_SLOT_OFF_HAND,
-                                        .defense_bonus = 1 },
-                         .visible_on_map = true,
-                       }));
-            break;
-        }
-        default:
-            ASSERT_M(false); // invalid option
-            break;
-        }
+// Bounding box of the cells changed after `generation`. The whole map when
+// the log no longer reaches back that far.
+bool map_changed_since(const rg_map *m, uint32_t generation, SDL_Rect *area)
+{
+    const uint32_t behind = m->generation - generation;
+    if (behind == 0) return false;
+    if (behind > MAP_CHANGE_LOG_LEN)
+    {
+        *area = (SDL_Rect){ .x = 0, .y = 0, .w = m->width, .h = m->height };
+        return true;
     }
+    const SDL_Point *first = &m->changes[generation % MAP_CHANGE_LOG_LEN];
+    int x0 = first->x;
+    int y0 = first->y;
+    int x1 = first->x;
+    int y1 = first->y;
+    for (uint32_t g = generation + 1; g != m->generation; g++)
+    {
+        const SDL_Point *p = &m->changes[g % MAP_CHANGE_LOG_LEN];
+        x0 = MIN(x0, p->x);
+        y0 = MIN(y0, p->y);
+        x1 = MAX(x1, p->x);
+        y1 = MAX(y1, p->y);
+    }
+    *area = (SDL_Rect){ .x = x0, .y = y0, .w = x1 - x0 + 1, .h = y1 - y0 + 1 };
+    return true;
 }
 
-void room_get_center(SDL_Rect *r, int *x, int *y)
+// Sets or clears cells [x0, x1) of row y, a chunk row word at a time.
+void map_fill_row(
+  rg_map *m, rg_map_plane plane, int y, int x0, int x1, bool value)
 {
-    if (x != NULL)
+    ASSERT_M(plane < MAP_PLANE_LEN);
+    ASSERT_M(y >= 0 && y < m->height);
+    ASSERT_M(x0 >= 0 && x0 <= x1 && x1 <= m->width);
+    while (x0 < x1)
     {
-        *x = (r->x + r->x + r->w) / 2;
+        const int base = x0 & ~MAP_CHUNK_MASK;
+        const int end = MIN(x1 - base, MAP_CHUNK_SIZE);
+        rg_map_chunk *c = map_chunk_at(m, x0, y);
+        uint64_t *row = &c->planes[plane][y & MAP_CHUNK_MASK];
+        const uint64_t mask = chunk_span(x0 - base, end);
+        *row = value ? (*row | mask) : (*row & ~mask);
+        x0 = base + MAP_CHUNK_SIZE;
     }
-    if (y != NULL)
+}
+
+// Turns cells [x0, x1) of row y into open floor.
+void map_carve_row(rg_map *m, int y, int x0, int x1)
+{
+    ASSERT_M(y >= 0 && y < m->height);
+    ASSERT_M(x0 >= 0 && x0 <= x1 && x1 <= m->width);
+    while (x0 < x1)
     {
-        *y = (r->y + r->y + r->h) / 2;
+        const int base = x0 & ~MAP_CHUNK_MASK;
+        const int end = MIN(x1 - base, MAP_CHUNK_SIZE);
+        chunk_carve(map_chunk_at(m, x0, y), y & MAP_CHUNK_MASK, x0 - base, end);
+        x0 = base + MAP_CHUNK_SIZE;
     }
 }
 
-bool room_intersects(SDL_Rect *lhs, SDL_Rect *rhs)
+void cell_bits_create(rg_cell_bits *b, int width, int height)
+{
+    b->stride = (width + 63) / 64;
+    b->height = height;
+    b->bits = calloc((size_t)b->stride * height, sizeof(*b->bits));
+    ASSERT_M(b->bits != NULL);
+}
+
+void cell_bits_destroy(rg_cell_bits *b)
+{
+    free(b->bits);
+    b->bits = NULL;
+}
+
+void cell_bits_clear(rg_cell_bits *b)
 {
-    return SDL_HasIntersection(lhs, rhs);
-}
\ No newline at end of file
+    memset(b->bits, 0, sizeof(*b->bits) * b->stride * b->height);
+}
+
+void tile_view_create(rg_tile_view *v, const rg_map *m)
+{
+    v->map = m;
+    v->bounds = (SDL_Rect){ .x = 0, .y = 0, .w = m->width, .h = m->height };
+    v->blockers = NULL;
+    v->exempt = (SDL_Point){ .x = -1, .y = -1 };
+    v->opaque = NULL;
+    v->impassable = NULL;
+}
+
+bool tile_view_is_walkable(const rg_tile_view *v, int x, int y)
+{
+    const SDL_Point p = { .x = x, .y = y };
+    if (!SDL_PointInRect(&p, &v->bounds)) return false;
+    if (map_get_fast(v->map, MAP_PLANE_BLOCKED, x, y)) return false;
+    if (v->impassable != NULL && cell_bits_get(v->impassable, x, y))
+        return false;
+    return v->blockers == NULL || !cell_bits_get(v->blockers, x, y) ||
+           (x == v->exempt.x && y == v->exempt.y);
+}
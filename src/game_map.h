@@ -3,64 +3,231 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include <SDL.h>
 
-#include "entity.h"
+#include "rle.h"
 #include "types.h"
-#include "inventory.h"
 
-typedef struct rg_tile
+// Chunks are square so that one plane word holds one chunk row.
+#define MAP_CHUNK_SHIFT 6
+#define MAP_CHUNK_SIZE (1 << MAP_CHUNK_SHIFT)
+#define MAP_CHUNK_MASK (MAP_CHUNK_SIZE - 1)
+// Chunks further than this from the player, in chunks, get evicted.
+#define MAP_CHUNK_KEEP 2
+// Terrain changes remembered for consumers catching up, a power of two.
+#define MAP_CHANGE_LOG_LEN 256
+
+typedef enum rg_tile_type
+{
+    TILE_WALL,
+    TILE_FLOOR,
+    TILE_DOOR_CLOSED,
+    TILE_DOOR_OPEN,
+
+    TILE_TYPE_LEN, // at most 16, the savefile stores one hex digit per cell
+} rg_tile_type;
+
+typedef enum rg_map_plane
+{
+    MAP_PLANE_BLOCKED,
+    MAP_PLANE_BLOCK_SIGHT,
+    MAP_PLANE_EXPLORED,
+
+    MAP_PLANE_LEN,
+} rg_map_plane;
+
+// Tile flags of one chunk, one bit per cell per plane.
+typedef struct rg_map_chunk
 {
-    bool blocked;
-    bool block_sight;
-    bool explored;
-} rg_tile;
+    uint64_t planes[MAP_PLANE_LEN][MAP_CHUNK_SIZE];
+    uint8_t types[MAP_CHUNK_SIZE * MAP_CHUNK_SIZE]; // rg_tile_type per cell
+} rg_map_chunk;
 
-typedef struct rg_tile_array
+typedef struct rg_map_rects
 {
     size_t len;
     size_t capacity;
-    rg_tile *data;
-} rg_tile_array;
+    SDL_Rect *data;
+} rg_map_rects;
+
+// What map_gen builds the chunks from. A chunk only depends on this and its
+// position, so chunks can be generated in any order.
+typedef struct rg_map_layout
+{
+    int kind; // rg_map_gen_kind
+    uint64_t seed;
+    int room_min_size;
+    int room_max_size;
+    int max_rooms; // per chunk
+    SDL_Point start; // chunk the player starts in
+    SDL_Point exit;  // chunk holding the stairs down
+} rg_map_layout;
+
+// Where an evicted chunk sits in the cache file, run length encoded.
+typedef struct rg_map_cache_slot
+{
+    long offset; // -1 while not in the cache file
+    long len;    // encoded bytes
+    long room;   // bytes reserved at offset, a later eviction may reuse them
+} rg_map_cache_slot;
 
+// Chunks are generated when the player first comes near them, written to a
+// cache file when the player moves away and read back when they are needed
+// again. A chunk that was never generated reads as solid rock.
 typedef struct rg_map
 {
     int width;
     int height;
-    rg_tile_array tiles;
+    int chunks_wide;
+    int chunks_high;
+    rg_map_chunk **chunks; // NULL while not resident
+    bool *built;           // per chunk, set once it was generated
+    rg_map_cache_slot *cache_slots; // per chunk
+    FILE *cache;
+    long cache_len;
+    rg_bytes cache_buf; // encoded chunk on its way to or from the cache
+    rg_map_layout layout;
     int level;
+    // Bumped by every terrain change. The cell changed at generation g sits
+    // at changes[(g - 1) % MAP_CHANGE_LOG_LEN].
+    uint32_t generation;
+    SDL_Point changes[MAP_CHANGE_LOG_LEN];
 } rg_map;
 
-void map_create(rg_map *m,
-                int w,
-                int h,
-                int level,
-                int room_min_size,
-                int room_max_size,
-                int max_rooms,
-                int max_monsters_per_room,
-                int max_items_per_room,
-                rg_entity_array *entities,
-                rg_items* items,
-                rg_entity_id player);
 void map_destroy(rg_map *m);
 
-void map_set_tile(rg_map *m, int x, int y, rg_tile tile);
-rg_tile *map_get_tile(rg_map *m, int x, int y);
+void map_alloc(rg_map *m, int width, int height, int level);
+
+rg_map_chunk *map_chunk_fetch(rg_map *m, int cx, int cy);
+rg_map_chunk *map_chunk_build(rg_map *m, int cx, int cy);
+const rg_map_chunk *map_chunk_peek(rg_map *m,
+                                   int cx,
+                                   int cy,
+                                   rg_map_chunk *scratch);
+void map_fetch_area(rg_map *m, const SDL_Rect *area);
+bool map_chunk_is_built(const rg_map *m, int cx, int cy);
+void map_stream(rg_map *m, int x, int y);
+
+// The checked accessors fetch the chunk they touch, which may read it back
+// from the cache.
+bool map_get(rg_map *m, rg_map_plane plane, int x, int y);
+void map_set(rg_map *m, rg_map_plane plane, int x, int y, bool value);
 bool map_is_blocked(rg_map *m, int x, int y);
+rg_tile_type map_get_type(rg_map *m, int x, int y);
+
+void map_set_tile(rg_map *m, int x, int y, rg_tile_type type);
+bool map_changed_since(const rg_map *m, uint32_t generation, SDL_Rect *area);
+
+void map_fill_row(
+  rg_map *m, rg_map_plane plane, int y, int x0, int x1, bool value);
+void map_carve_row(rg_map *m, int y, int x0, int x1);
 
-void map_create_room(rg_map *m, SDL_Rect room);
-void map_create_h_tunnel(rg_map *m, int x1, int x2, int y);
-void map_create_v_tunnel(rg_map *m, int y1, int y2, int x);
-void map_place_entities(rg_map *m,
-                        SDL_Rect *room,
-                        rg_entity_array *entities,
-                        int max_monsters_per_room,
-                        rg_items* items,
-                        int max_items_per_room);
-
-void room_get_center(SDL_Rect *r, int *x, int *y);
-bool room_intersects(SDL_Rect *lhs, SDL_Rect *rhs);
+static inline bool map_chunk_get(const rg_map_chunk *c,
+                                 rg_map_plane plane,
+                                 int x,
+                                 int y)
+{
+    const uint64_t row = c->planes[plane][y & MAP_CHUNK_MASK];
+    return (row >> (x & MAP_CHUNK_MASK)) & 1;
+}
+
+static inline void map_chunk_set(rg_map_chunk *c,
+                                 rg_map_plane plane,
+                                 int x,
+                                 int y,
+                                 bool value)
+{
+    uint64_t *row = &c->planes[plane][y & MAP_CHUNK_MASK];
+    const uint64_t bit = 1ull << (x & MAP_CHUNK_MASK);
+    *row = value ? (*row | bit) : (*row & ~bit);
+}
+
+static inline rg_tile_type map_chunk_type(const rg_map_chunk *c, int x, int y)
+{
+    const int lx = x & MAP_CHUNK_MASK;
+    const int ly = y & MAP_CHUNK_MASK;
+    return c->types[lx + ly * MAP_CHUNK_SIZE];
+}
+
+// The resident chunk holding (x, y). Never fetches, the caller made the area
+// resident with map_chunk_fetch or map_fetch_area and hasn't streamed since.
+static inline rg_map_chunk *map_chunk_resident(const rg_map *m, int x, int y)
+{
+    const int cx = x >> MAP_CHUNK_SHIFT;
+    const int cy = y >> MAP_CHUNK_SHIFT;
+    rg_map_chunk *c = m->chunks[cx + cy * m->chunks_wide];
+    ASSERT_M(c != NULL);
+    return c;
+}
+
+// Unchecked variants for inner loops, the caller keeps x and y in bounds and
+// within resident chunks. They never touch the cache.
+static inline bool map_get_fast(const rg_map *m,
+                                rg_map_plane plane,
+                                int x,
+                                int y)
+{
+    return map_chunk_get(map_chunk_resident(m, x, y), plane, x, y);
+}
+
+static inline void map_set_fast(rg_map *m,
+                                rg_map_plane plane,
+                                int x,
+                                int y,
+                                bool value)
+{
+    map_chunk_set(map_chunk_resident(m, x, y), plane, x, y, value);
+}
+
+// One bit per map cell, rows padded to whole words.
+typedef struct rg_cell_bits
+{
+    int stride; // words per row
+    int height;
+    uint64_t *bits;
+} rg_cell_bits;
+
+void cell_bits_create(rg_cell_bits *b, int width, int height);
+void cell_bits_destroy(rg_cell_bits *b);
+void cell_bits_clear(rg_cell_bits *b);
+
+static inline bool cell_bits_get(const rg_cell_bits *b, int x, int y)
+{
+    return (b->bits[y * b->stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline void cell_bits_set(rg_cell_bits *b, int x, int y, bool value)
+{
+    uint64_t *word = &b->bits[y * b->stride + (x >> 6)];
+    const uint64_t bit = 1ull << (x & 63);
+    *word = value ? (*word | bit) : (*word & ~bit);
+}
+
+// Read access to the map's tile properties for FOV and pathfinding. Nothing
+// is copied, the map stays the only store of blocked and transparent cells.
+// Reads never fetch: make the bounds resident with map_fetch_area first.
+typedef struct rg_tile_view
+{
+    const rg_map *map;
+    SDL_Rect bounds; // cells outside are not walkable
+    const rg_cell_bits *blockers;   // e.g. entities, may be NULL
+    SDL_Point exempt;               // walkable despite the blockers
+    const rg_cell_bits *opaque;     // e.g. thick gas, may be NULL
+    const rg_cell_bits *impassable; // e.g. fire, may be NULL
+} rg_tile_view;
+
+void tile_view_create(rg_tile_view *v, const rg_map *m);
+bool tile_view_is_walkable(const rg_tile_view *v, int x, int y);
+
+static inline bool tile_view_is_transparent(const rg_tile_view *v,
+                                            int x,
+                                            int y)
+{
+    if (map_get_fast(v->map, MAP_PLANE_BLOCK_SIGHT, x, y)) return false;
+    return v->opaque == NULL || !cell_bits_get(v->opaque, x, y);
+}
 
 #endif
\ No newline at end of file
@@ -4,11 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "app.h"
 #include "array.h"
 #include "astar.h"
 #include "color.h"
+#include "map_gen.h"
 #include "savefile.h"
 #include "ui.h"
 
@@ -56,28 +58,26 @@ static void entity_move_towards(rg_entity* e,
 static void entity_move_astar(rg_entity* e,
                               rg_entity* target,
                               rg_map* game_map,
+                              const rg_hazards* hazards,
+                              const rg_cell_bits* blockers,
                               rg_entity_array* entities)
 {
-    rg_fov_map map;
-    fov_map_create(&map, game_map->width, game_map->height);
-    for (int y = 0; y < game_map->height; y++)
-    {
-        for (int x = 0; x < game_map->width; x++)
-        {
-            rg_tile* t = map_get_tile(game_map, x, y);
-            fov_map_set_props(&map, x, y, !t->block_sight, !t->blocked);
-        }
-    }
-    for (int i = 0; i < entities->len; i++)
-    {
-        rg_entity* t = &entities->data[i];
-        if (t->blocks && t != e && t != target)
-        {
-            fov_map_set_props(&map, t->x, t->y, true, false);
-        }
-    }
-
-    astar_path* path = astar_path_new_using_map(&map, (float)1.41);
+    // The search stays within the area a path of the length limit can
+    // reach, other blocking entities are an overlay on the map. `e` is not in
+    // `blockers` and the target is exempt from them.
+    rg_tile_view view;
+    tile_view_create(&view, game_map);
+    const int x0 = MAX(0, MIN(e->x, target->x) - 25);
+    const int y0 = MAX(0, MIN(e->y, target->y) - 25);
+    const int x1 = MIN(game_map->width, MAX(e->x, target->x) + 26);
+    const int y1 = MIN(game_map->height, MAX(e->y, target->y) + 26);
+    view.bounds = (SDL_Rect){ .x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0 };
+    view.impassable = &hazards->impassable;
+    view.blockers = blockers;
+    view.exempt = (SDL_Point){ .x = target->x, .y = target->y };
+    map_fetch_area(game_map, &view.bounds);
+
+    astar_path* path = astar_path_new_using_view(&view, (float)1.41);
     astar_path_compute(path, e->x, e->y, target->x, target->y);
 
     if (!astar_path_is_empty(path) && astar_path_size(path) < 25)
@@ -102,6 +102,8 @@ static void basic_monster_update(rg_entity* e,
                                  rg_player_equipments* player_equipments,
                                  rg_fov_map* fov_map,
                                  rg_map* game_map,
+                                 const rg_hazards* hazards,
+                                 const rg_cell_bits* blockers,
                                  rg_entity_array* entities,
                                  rg_turn_logs* logs,
                                  rg_entity** dead_entity)
@@ -119,7 +121,8 @@ static void basic_monster_update(rg_entity* e,
         int distance = (int)entity_get_distance(e, target);
         if (distance >= 2)
         {
-            entity_move_astar(e, target, game_map, entities);
+            entity_move_astar(
+              e, target, game_map, hazards, blockers, entities);
         }
         else if (target->fighter.hp > 0)
         {
@@ -153,6 +156,7 @@ static void handle_player_movement(const rg_action* action,
         if (target == NULL)
         {
             entity_move(player, action->dx, action->dy);
+            spatial_grid_update(&data->spatial, &data->entities, data->player);
             data->recompute_fov = true;
         }
         else
@@ -216,6 +220,16 @@ static void handle_player_movement(const rg_action* action,
         if (data->game_state != ST_TURN_PLAYER_DEAD)
             data->game_state = ST_TURN_ENEMY;
     }
+    else if (destination_x >= 0 && destination_x < game_map->width &&
+             destination_y >= 0 && destination_y < game_map->height &&
+             map_get_type(game_map, destination_x, destination_y) ==
+               TILE_DOOR_CLOSED)
+    {
+        // Opening takes the turn, the view catches up through the map's
+        // change log.
+        map_set_tile(game_map, destination_x, destination_y, TILE_DOOR_OPEN);
+        data->game_state = ST_TURN_ENEMY;
+    }
 }
 
 static void handle_player_pickup(const rg_action* action,
@@ -223,16 +237,14 @@ static void handle_player_pickup(const rg_action* action,
 {
     rg_entity* player = &data->entities.data[data->player];
     bool status = false;
-    for (int i = 0; i < data->items.len; i++)
+    int idx = item_stacks_top(&data->item_stacks, player->x, player->y);
+    if (idx != -1)
     {
-        rg_item* e = &data->items.data[i];
-        if (e->x == player->x && e->y == player->y && e->visible_on_map)
-        {
-            inventory_add_item(&data->inventory, &data->items, i, &data->logs);
-            status = true;
-            data->game_state = ST_TURN_ENEMY;
-            break;
-        }
+        if (inventory_add_item(
+              &data->inventory, &data->items.data[idx], &data->logs) != NULL)
+            item_stacks_take(&data->item_stacks, &data->items, idx, NULL);
+        status = true;
+        data->game_state = ST_TURN_ENEMY;
     }
     if (!status)
     {
@@ -257,6 +269,8 @@ static void handle_entity_follow_player(rg_entity* e,
                                         rg_player_equipments* player_equipments,
                                         rg_fov_map* fov_map,
                                         rg_map* game_map,
+                                        const rg_hazards* hazards,
+                                        const rg_cell_bits* blockers,
                                         rg_entity_array* entities,
                                         rg_turn_logs* logs,
                                         rg_entity** dead_entity)
@@ -266,6 +280,8 @@ static void handle_entity_follow_player(rg_entity* e,
                          player_equipments,
                          fov_map,
                          game_map,
+                         hazards,
+                         blockers,
                          entities,
                          logs,
                          dead_entity);
@@ -279,12 +295,13 @@ static void handle_entity_confused(rg_entity* e,
                                    rg_map* game_map,
                                    rg_entity_array* entities,
                                    rg_turn_logs* logs,
+                                   rg_rng* rng,
                                    rg_entity** dead_entity)
 {
     if (e->state.data.confused.num_turns > 0)
     {
-        int x = RAND_INT(0, 2) - 1;
-        int y = RAND_INT(0, 2) - 1;
+        int x = rng_int(rng, -1, 1);
+        int y = rng_int(rng, -1, 1);
 
         if (x != e->x && y != e->y)
             entity_move_towards(e, x, y, game_map, entities);
@@ -295,9 +312,9 @@ static void handle_entity_confused(rg_entity* e,
         e->state.type = e->state.data.confused.prev_state;
 
         const char* fmt = "The %s is no longer confused!";
-        int len = snprintf(NULL, 0, fmt, e->name);
+        int len = snprintf(NULL, 0, fmt, entity_name(e));
         char* buf = malloc(sizeof(char) * (len + 1));
-        snprintf(buf, len, fmt, e->name);
+        snprintf(buf, len, fmt, entity_name(e));
         rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                     .text = buf,
                                     .color = RED };
@@ -310,8 +327,11 @@ static void enemy_state_update(rg_entity* e,
                                rg_player_equipments* player_equipments,
                                rg_fov_map* fov_map,
                                rg_map* game_map,
+                               const rg_hazards* hazards,
+                               const rg_cell_bits* blockers,
                                rg_entity_array* entities,
                                rg_turn_logs* logs,
+                               rg_rng* rng,
                                rg_entity** dead_entity)
 {
     switch (e->state.type)
@@ -326,6 +346,8 @@ static void enemy_state_update(rg_entity* e,
                                     player_equipments,
                                     fov_map,
                                     game_map,
+                                    hazards,
+                                    blockers,
                                     entities,
                                     logs,
                                     dead_entity);
@@ -336,7 +358,7 @@ static void enemy_state_update(rg_entity* e,
         break;
     case ENTITY_STATE_CONFUSED:
         handle_entity_confused(
-          e, target, fov_map, game_map, entities, logs, dead_entity);
+          e, target, fov_map, game_map, entities, logs, rng, dead_entity);
         break;
     }
 }
@@ -477,16 +499,16 @@ static void handle_targeting_input(const SDL_Event* event,
                                    rg_action* action,
                                    rg_game_state_data* data)
 {
-    Uint32 btn = SDL_GetMouseState(NULL, NULL);
-    if ((btn & SDL_BUTTON_LMASK) != 0)
+    const bool click = event->type == SDL_MOUSEBUTTONDOWN;
+    if (click && event->button.button == SDL_BUTTON_LEFT)
     {
-        data->target_x = data->mouse_position.x;
-        data->target_y = data->mouse_position.y;
+        data->target_x = data->mouse_position.x + data->camera.x;
+        data->target_y = data->mouse_position.y + data->camera.y;
         action->type = ACTION_TARGET_SELECTED;
         data->target_selected = true;
         return;
     }
-    else if ((btn & SDL_BUTTON_RMASK) != 0)
+    else if (click && event->button.button == SDL_BUTTON_RIGHT)
     {
         action->type = ACTION_ESCAPE;
         data->target_selected = false;
@@ -507,12 +529,6 @@ static void handle_targeting_input(const SDL_Event* event,
     }
 }
 
-static int entity_sort_by_render_order(const rg_entity* lhs,
-                                       const rg_entity* rhs)
-{
-    return lhs->render_order - rhs->render_order;
-}
-
 static void render_bar(rg_console* c,
                        int x,
                        int y,
@@ -538,9 +554,9 @@ static void render_bar(rg_console* c,
 
 static char* get_names_under_mouse(rg_game_state_data* data)
 {
-    const int x = data->mouse_position.x;
-    const int y = data->mouse_position.y;
-    ASSERT_M(x >= 0 && x <= 800);
+    const int x = data->mouse_position.x + data->camera.x;
+    const int y = data->mouse_position.y + data->camera.y;
+    if (!fov_map_in_bounds(&data->fov_map, x, y)) return NULL;
     char* buf = NULL;
     size_t buf_len = 0;
     for (int i = 0; i < data->entities.len; i++)
@@ -549,48 +565,48 @@ static char* get_names_under_mouse(rg_game_state_data* data)
         rg_fov_map* fov_map = &data->fov_map;
         if (e->x == x && e->y == y && fov_map_is_in_fov(fov_map, x, y))
         {
+            const char* name = entity_name(e);
             if (buf == NULL)
             {
-                buf_len = strlen(e->name);
-                buf = strdup(e->name);
+                buf_len = strlen(name);
+                buf = strdup(name);
             }
             else
             {
-                size_t sz = strlen(e->name);
+                size_t sz = strlen(name);
                 size_t newsize = sizeof(char) * (buf_len + sz + 3);
                 buf = realloc(buf, newsize);
                 ASSERT_M(buf != NULL);
                 buf[buf_len] = ',';
                 buf[buf_len + 1] = ' ';
                 buf_len += 2;
-                memcpy(buf + buf_len, e->name, sz);
+                memcpy(buf + buf_len, name, sz);
                 buf_len += sz;
                 buf[buf_len] = '\0';
             }
         }
     }
-    for (int i = 0; i < data->items.len; i++)
+    if (fov_map_is_in_fov(&data->fov_map, x, y))
     {
-        const rg_item* e = &data->items.data[i];
-        rg_fov_map* fov_map = &data->fov_map;
-        if (e->x == x && e->y == y && e->visible_on_map &&
-            fov_map_is_in_fov(fov_map, x, y))
+        int i = item_stacks_top(&data->item_stacks, x, y);
+        for (; i != -1; i = item_stacks_next(&data->item_stacks, i))
         {
+            const char* name = item_proto(&data->items.data[i])->name;
             if (buf == NULL)
             {
-                buf_len = strlen(e->name);
-                buf = strdup(e->name);
+                buf_len = strlen(name);
+                buf = strdup(name);
             }
             else
             {
-                size_t sz = strlen(e->name);
+                size_t sz = strlen(name);
                 size_t newsize = sizeof(char) * (buf_len + sz + 3);
                 buf = realloc(buf, newsize);
                 ASSERT_M(buf != NULL);
                 buf[buf_len] = ',';
                 buf[buf_len + 1] = ' ';
                 buf_len += 2;
-                memcpy(buf + buf_len, e->name, sz);
+                memcpy(buf + buf_len, name, sz);
                 buf_len += sz;
                 buf[buf_len] = '\0';
             }
@@ -599,56 +615,213 @@ static char* get_names_under_mouse(rg_game_state_data* data)
     return buf;
 }
 
-static void game_level_create(rg_game_state_data* data, int level)
+// Generates the chunks the player comes close to and indexes what spawned
+// in them.
+static void game_generate_near(rg_game_state_data* data)
 {
-    map_create(&data->game_map,
-               data->map_width,
-               data->map_height,
-               level,
-               data->room_min_size,
-               data->room_max_size,
-               data->max_rooms,
-               data->max_monsters_per_room,
-               data->max_items_per_room,
-               &data->entities,
-               &data->items,
-               data->player);
+    const size_t entities_len = data->entities.len;
+    const size_t items_len = data->items.len;
+    const rg_entity* player = &data->entities.data[data->player];
+    if (!map_generate_near(&data->game_map,
+                           player->x,
+                           player->y,
+                           &data->entities,
+                           &data->items,
+                           data->player))
+        return;
+    for (size_t i = entities_len; i < data->entities.len; i++)
+        spatial_grid_update(&data->spatial, &data->entities, i);
+    for (size_t i = items_len; i < data->items.len; i++)
+        item_stacks_link(&data->item_stacks, &data->items, i);
+}
 
-    fov_map_create(&data->fov_map, data->map_width, data->map_height);
-    for (int y = 0; y < data->map_height; y++)
+// Generates and streams the chunks around the player and computes what it
+// sees. FOV reads the map directly, there is nothing to sync.
+static void game_compute_fov(rg_game_state_data* data)
+{
+    rg_map* m = &data->game_map;
+    game_generate_near(data);
+    const rg_entity* player = &data->entities.data[data->player];
+    map_stream(m, player->x, player->y);
+    data->fov_generation = m->generation;
+    rg_tile_view view;
+    tile_view_create(&view, m);
+    view.opaque = &data->hazards.opaque;
+    if (data->fov_radius > 0)
     {
-        for (int x = 0; x < data->map_width; x++)
-        {
-            rg_tile* tile = map_get_tile(&data->game_map, x, y);
-            fov_map_set_props(
-              &data->fov_map, x, y, !tile->block_sight, !tile->blocked);
-        }
+        // Lighting walls looks one cell past the radius.
+        const int r = data->fov_radius + 1;
+        view.bounds = (SDL_Rect){ .x = player->x - r,
+                                  .y = player->y - r,
+                                  .w = 2 * r + 1,
+                                  .h = 2 * r + 1 };
     }
-
-    // first draw before waitevent
+    map_fetch_area(m, &view.bounds);
     fov_map_compute(&data->fov_map,
-                    data->entities.data[data->player].x,
-                    data->entities.data[data->player].y,
+                    &view,
+                    player->x,
+                    player->y,
                     data->fov_radius,
                     data->fov_light_walls);
 }
 
-static void game_next_level(rg_game_state_data* data)
+// True when the player moved or terrain changed within sight range since the
+// last computation, changes further away can't alter what is visible.
+static bool game_fov_is_stale(const rg_game_state_data* data)
 {
-    int level = data->game_map.level;
-    if (data->player != 0)
+    if (data->recompute_fov) return true;
+    SDL_Rect changed;
+    if (!map_changed_since(&data->game_map, data->fov_generation, &changed))
+        return false;
+    if (data->fov_radius <= 0) return true;
+    const rg_entity* player = &data->entities.data[data->player];
+    const SDL_Rect sight = { .x = player->x - data->fov_radius,
+                             .y = player->y - data->fov_radius,
+                             .w = 2 * data->fov_radius + 1,
+                             .h = 2 * data->fov_radius + 1 };
+    return SDL_HasIntersection(&changed, &sight);
+}
+
+// Glyph of the strongest hazard on a cell, false when there is none.
+static bool game_hazard_glyph(const rg_game_state_data* data,
+                              int x,
+                              int y,
+                              char* ch,
+                              SDL_Color* color)
+{
+    const rg_hazards* h = &data->hazards;
+    if (hazards_get(h, HAZARD_FIRE, x, y) > 0)
+    {
+        *ch = '^';
+        *color = FLAME;
+    }
+    else if (hazards_get(h, HAZARD_WATER, x, y) > 0)
+    {
+        *ch = '~';
+        *color = SKY;
+    }
+    else if (hazards_get(h, HAZARD_GAS, x, y) > 0)
+    {
+        *ch = ':';
+        *color = LIGHT_GREY;
+    }
+    else
     {
-        rg_entity* p = &data->entities.data[data->player];
-        data->player = 0;
-        memcpy(data->entities.data, p, sizeof(*p));
+        return false;
     }
-    data->entities.len = 1;
+    return true;
+}
+
+// Centers the view on the player, clamped to the map edges.
+static void game_update_camera(rg_game_state_data* data)
+{
+    const rg_entity* player = &data->entities.data[data->player];
+    const int max_x = MAX(0, data->game_map.width - data->view_width);
+    const int max_y = MAX(0, data->game_map.height - data->view_height);
+    const int x = player->x - data->view_width / 2;
+    const int y = player->y - data->view_height / 2;
+    data->camera.x = MAX(0, MIN(x, max_x));
+    data->camera.y = MAX(0, MIN(y, max_y));
+}
+
+static void game_level_params(rg_game_state_data* data,
+                              rg_level_params* params)
+{
+    params->map_width = data->map_width;
+    params->map_height = data->map_height;
+    params->room_min_size = data->room_min_size;
+    params->room_max_size = data->room_max_size;
+    params->max_rooms = data->max_rooms;
+    params->max_monsters_per_room = data->max_monsters_per_room;
+    params->max_items_per_room = data->max_items_per_room;
+}
+
+// Takes ownership of everything in `l` and moves the player into its slot.
+static void game_level_install(rg_game_state_data* data, rg_level* l)
+{
+    rg_entity* player = &l->entities.data[0];
+    int x = player->x;
+    int y = player->y;
+    *player = data->entities.data[data->player];
+    player->x = x;
+    player->y = y;
+    free(data->entities.data);
+    free(data->items.data);
+
+    data->player = 0;
+    data->game_map = l->map;
+    data->fov_map = l->fov_map;
+    data->entities = l->entities;
+    data->spatial = l->spatial;
+    data->items = l->items;
+    data->item_stacks = l->item_stacks;
+    data->hazards = l->hazards;
+    cell_bits_create(&data->blockers, l->map.width, l->map.height);
+    map_memory_create(&data->memory, &data->game_map);
+}
+
+// Level `level` is generated from the level-th split of the map stream. The
+// map stream itself never advances, so a level comes out the same whether it
+// was pregenerated, generated on the spot or generated after loading a save.
+static void game_level_rng(rg_game_state_data* data, int level, rg_rng* out)
+{
+    ASSERT_M(level > 0);
+    rg_rng map = *rng_stream(&data->rng, RNG_STREAM_MAP);
+    for (int i = 0; i < level; i++) rng_split(&map, out);
+}
+
+static void game_level_create(rg_game_state_data* data, int level)
+{
+    rg_level_params params;
+    game_level_params(data, &params);
+    rg_level l;
+    if (level_cache_take(&data->level_cache, level, &l))
+    {
+        // Going back up, the level pregenerated below is not needed.
+        level_pregen_cancel(&data->pregen);
+    }
+    else if (!level_pregen_take(&data->pregen, level, &l))
+    {
+        rg_rng rng;
+        game_level_rng(data, level, &rng);
+        level_generate(&l, &params, level, &rng, NULL);
+    }
+    game_level_install(data, &l);
+
+    // first draw before waitevent
+    game_compute_fov(data);
+
+    if (!level_cache_contains(&data->level_cache, level + 1))
+    {
+        rg_rng next;
+        game_level_rng(data, level + 1, &next);
+        level_pregen_start(&data->pregen, &params, level + 1, &next);
+    }
+}
+
+// Leaves the current level by its stairs. The level goes into the cache so
+// it can be entered again.
+static void game_change_level(rg_game_state_data* data, int level)
+{
     rg_entity* p = &data->entities.data[data->player];
-    p->fighter.hp = (int)floor(p->fighter.max_hp / 2.0);
+    if (level > data->game_map.level)
+        p->fighter.hp = (int)floor(p->fighter.max_hp / 2.0);
+    // Carried items live in the inventory, whatever is on the floor stays
+    // behind with the old level.
+    level_cache_store(&data->level_cache,
+                      &data->game_map,
+                      &data->entities,
+                      data->player,
+                      &data->items);
     map_destroy(&data->game_map);
     fov_map_destroy(&data->fov_map);
+    spatial_grid_destroy(&data->spatial);
+    item_stacks_destroy(&data->item_stacks);
+    hazards_destroy(&data->hazards);
+    cell_bits_destroy(&data->blockers);
+    map_memory_destroy(&data->memory);
 
-    game_level_create(data, level + 1);
+    game_level_create(data, level);
 }
 
 static void with_defaults(rg_game_state_data* data, rg_app* app)
@@ -663,11 +836,14 @@ static void with_defaults(rg_game_state_data* data, rg_app* app)
     data->message_x = data->bar_width + 2;
     data->message_width = data->screen_width - data->bar_width - 2;
     data->message_height = data->panel_height - 1;
-    data->map_width = 80;
-    data->map_height = 43;
+    data->map_width = app->map_width;
+    data->map_height = app->map_height;
+    data->view_width = data->screen_width;
+    data->view_height = data->panel_y;
     data->room_max_size = 10;
     data->room_min_size = 6;
-    data->max_rooms = 30;
+    // Per chunk, as many rooms per area as on the old 80x43 map.
+    data->max_rooms = 30 * MAP_CHUNK_SIZE * MAP_CHUNK_SIZE / 3440;
     data->max_monsters_per_room = 3;
     data->max_items_per_room = 8;
     data->fov_light_walls = true;
@@ -679,29 +855,33 @@ static void with_defaults(rg_game_state_data* data, rg_app* app)
     data->target_x = -1;
     data->target_y = -1;
 
+    // The game only fills in cells, frames are rendered from copies of them.
     console_create(&data->console,
-                   app->renderer,
+                   NULL,
                    data->screen_width,
                    data->screen_height,
                    app->terminal.tileset);
     console_create(&data->panel,
-                   app->renderer,
+                   NULL,
                    data->screen_width,
                    data->panel_height,
                    app->terminal.tileset);
     console_create(&data->menu,
-                   app->renderer,
+                   NULL,
                    data->screen_width,
                    data->screen_height,
                    app->terminal.tileset);
 
     console_create(&data->character_screen,
-                   app->renderer,
+                   NULL,
                    data->screen_width,
                    data->screen_height,
                    app->terminal.tileset);
 
+    frame_create(&data->frame);
+
     inventory_create(&data->inventory, 26);
+    level_cache_create(&data->level_cache);
 }
 
 bool game_state_load_game(rg_game_state_data* data, rg_app* app)
@@ -711,56 +891,52 @@ bool game_state_load_game(rg_game_state_data* data, rg_app* app)
     with_defaults(data, app);
 
     savefile_load(data, SAVEFILE_NAME);
+    // A saved game keeps the size it was started with.
+    data->map_width = data->game_map.width;
+    data->map_height = data->game_map.height;
+
+    spatial_grid_create(&data->spatial, data->map_width, data->map_height);
+    spatial_grid_build(&data->spatial, &data->entities);
+    item_stacks_create(&data->item_stacks, data->map_width, data->map_height);
+    item_stacks_build(&data->item_stacks, &data->items);
 
     fov_map_create(&data->fov_map, data->map_width, data->map_height);
-    for (int y = 0; y < data->map_height; y++)
-    {
-        for (int x = 0; x < data->map_width; x++)
-        {
-            rg_tile* tile = map_get_tile(&data->game_map, x, y);
-            fov_map_set_props(
-              &data->fov_map, x, y, !tile->block_sight, !tile->blocked);
-        }
-    }
+    hazards_create(&data->hazards, data->map_width, data->map_height);
+    cell_bits_create(&data->blockers, data->map_width, data->map_height);
+    map_memory_create(&data->memory, &data->game_map);
 
     // first draw before waitevent
-    fov_map_compute(&data->fov_map,
-                    data->entities.data[data->player].x,
-                    data->entities.data[data->player].y,
-                    data->fov_radius,
-                    data->fov_light_walls);
+    game_compute_fov(data);
     data->mouse_position.x = 0;
     data->mouse_position.y = 0;
 
+    const int below = data->game_map.level + 1;
+    if (!level_cache_contains(&data->level_cache, below))
+    {
+        rg_level_params params;
+        game_level_params(data, &params);
+        rg_rng next;
+        game_level_rng(data, below, &next);
+        level_pregen_start(&data->pregen, &params, below, &next);
+    }
+
     return true;
 }
 
 void game_state_create_game(rg_game_state_data* data, rg_app* app)
 {
     with_defaults(data, app);
+    rng_streams_create(&data->rng,
+                       app->seed != 0 ? app->seed : (uint64_t)time(NULL));
 
     data->entities.capacity = data->max_monsters_per_room;
     data->entities.data =
       malloc(sizeof(*data->entities.data) * data->entities.capacity);
     ASSERT_M(data->entities.data != NULL);
     data->entities.len = 0;
-    data->items.capacity = data->max_items_per_room;
-    data->items.data = malloc(sizeof(*data->items.data) * data->items.capacity);
-    ASSERT_M(data->items.data != NULL);
-    data->items.len = 0;
-    rg_fighter fighter = { .hp = 100, .defence = 1, .power = 2, .max_hp = 100 };
-    ARRAY_PUSH(&data->entities,
-               ((rg_entity){
-                 .x = 0,
-                 .y = 0,
-                 .ch = '@',
-                 .color = WHITE,
-                 .name = "Player",
-                 .blocks = true,
-                 .type = ENTITY_PLAYER,
-                 .fighter = fighter,
-                 .render_order = RENDER_ORDER_ACTOR,
-               }));
+    rg_entity player;
+    entity_create(&player, ENTITY_PROTO_PLAYER, 0, 0);
+    ARRAY_PUSH(&data->entities, player);
     data->player = data->entities.len - 1;
 
     data->player_level.current_level = 1;
@@ -777,31 +953,29 @@ void game_state_create_game(rg_game_state_data* data, rg_app* app)
 
     {
         // Starting weapon
-        ARRAY_PUSH(
-          &data->items,
-          ((rg_item){
-            .x = 0,
-            .y = 0,
-            .ch = '-',
-            .color = SKY,
-            .name = "Dagger",
-            .type = ITEM_EQUIPMENT,
-            .equipable = { .slot = EQUIPMENT_SLOT_MAIN_HAND, .power_bonus = 2 },
-            .visible_on_map = true,
-          }));
-        size_t idx = data->items.len - 1;
-        inventory_add_item(&data->inventory, &data->items, idx, NULL);
+        rg_item dagger = { .x = 0, .y = 0, .proto = ITEM_PROTO_DAGGER };
+        rg_item* held = inventory_add_item(&data->inventory, &dagger, NULL);
         equipment_toggle_equip(
-          &data->player_equipments, &data->items.data[idx], NULL, NULL, NULL);
+          &data->player_equipments, held, NULL, NULL, NULL);
     }
 }
 
 void game_state_destroy(rg_game_state_data* data)
 {
+    level_pregen_cancel(&data->pregen);
+    level_cache_destroy(&data->level_cache);
     inventory_destroy(&data->inventory);
     turn_logs_destroy(&data->logs);
     map_destroy(&data->game_map);
+    fov_map_destroy(&data->fov_map);
+    spatial_grid_destroy(&data->spatial);
+    item_stacks_destroy(&data->item_stacks);
+    hazards_destroy(&data->hazards);
+    cell_bits_destroy(&data->blockers);
+    map_memory_destroy(&data->memory);
+    frame_destroy(&data->frame);
     free(data->entities.data);
+    free(data->items.data);
     console_destroy(&data->menu);
     console_destroy(&data->console);
     console_destroy(&data->panel);
@@ -825,6 +999,7 @@ void game_state_update(rg_app* app, SDL_Event* event, rg_game_state_data* data)
     if (action.type == ACTION_QUIT)
     {
         // App Quit signal
+        level_pregen_cancel(&data->pregen);
         savefile_save(data, SAVEFILE_NAME);
         app->screen = APP_SCREEN_MENU;
         return;
@@ -863,20 +1038,48 @@ void game_state_update(rg_app* app, SDL_Event* event, rg_game_state_data* data)
     if (action.type == ACTION_QUIT)
     {
         // App Quit signal
+        level_pregen_cancel(&data->pregen);
         savefile_save(data, SAVEFILE_NAME);
         app->screen = APP_SCREEN_MENU;
         return;
     }
 
-    if (data->recompute_fov)
-        fov_map_compute(&data->fov_map,
-                        data->entities.data[data->player].x,
-                        data->entities.data[data->player].y,
-                        data->fov_radius,
-                        data->fov_light_walls);
+    if (game_fov_is_stale(data)) game_compute_fov(data);
 }
 
-void game_state_draw(rg_app* app, rg_game_state_data* data)
+// True while the game has work to do that doesn't wait for input, it is
+// advanced by updating with an empty event.
+bool game_state_is_busy(const rg_game_state_data* data)
+{
+    return data->game_state == ST_TURN_ENEMY;
+}
+
+// Updates with one event, or with an empty one for NULL, and returns true if
+// the frame has to be composed again. Input first finishes a turn in progress
+// so it isn't swallowed by it.
+bool game_state_handle_event(rg_app* app,
+                             SDL_Event* event,
+                             rg_game_state_data* data)
+{
+    SDL_Event none = { 0 };
+    bool dirty = false;
+    if (event != NULL && game_state_is_busy(data))
+        dirty |= game_state_handle_event(app, NULL, data);
+    if (event == NULL) event = &none;
+
+    const app_screen screen = app->screen;
+    const rg_game_state state = data->game_state;
+    const SDL_Point hover = data->mouse_position;
+    game_state_update(app, event, data);
+    dirty |= app->screen != screen || data->game_state != state ||
+             data->mouse_position.x != hover.x ||
+             data->mouse_position.y != hover.y;
+    return dirty || event_forces_redraw(event);
+}
+
+// Fills in the consoles from the game state and captures them into `f`. Only
+// touches the game state, the frame is rendered elsewhere.
+void game_state_compose(rg_game_state_data* data, rg_frame* f)
 {
     rg_map* game_map = &data->game_map;
     rg_fov_map* fov_map = &data->fov_map;
@@ -884,83 +1087,111 @@ void game_state_draw(rg_app* app, rg_game_state_data* data)
     rg_entity_array* entities = &data->entities;
     rg_items* items = &data->items;
 
-    qsort(entities->data,
-          entities->len,
-          sizeof(*entities->data),
-          entity_sort_by_render_order);
-    for (int i = 0; i < entities->len; i++)
-        if (entities->data[i].type == ENTITY_PLAYER)
-        {
-            data->player = i;
-            break;
-        }
-
     ///-----GameWorld---------------
-    console_begin(&data->console);
-    console_clear(&data->console, BLACK);
-    for (int y = 0; y < game_map->height; y++)
+    // Remembered terrain is copied in first, only what is in sight is drawn
+    // over it from the map.
+    console_clear(&data->console, ((SDL_Color){ 0, 0, 0, 0 }));
+    game_update_camera(data);
+    const SDL_Point cam = data->camera;
+    const int view_w = MIN(data->view_width, game_map->width);
+    const int view_h = MIN(data->view_height, game_map->height);
+    {
+        const SDL_Rect view = {
+            .x = cam.x, .y = cam.y, .w = view_w, .h = view_h
+        };
+        map_memory_draw(&data->memory, game_map, &view, console);
+    }
+    SDL_Rect sight = { .x = 0, .y = 0, .w = view_w, .h = view_h };
+    if (data->fov_radius > 0)
     {
-        for (int x = 0; x < game_map->width; x++)
+        const rg_entity* player = &entities->data[data->player];
+        const SDL_Rect around = { .x = player->x - cam.x - data->fov_radius,
+                                  .y = player->y - cam.y - data->fov_radius,
+                                  .w = 2 * data->fov_radius + 1,
+                                  .h = 2 * data->fov_radius + 1 };
+        SDL_Rect view = sight;
+        if (!SDL_IntersectRect(&view, &around, &sight)) sight.w = 0;
+    }
+    {
+        const SDL_Rect area = { .x = sight.x + cam.x,
+                                .y = sight.y + cam.y,
+                                .w = sight.w,
+                                .h = sight.h };
+        map_fetch_area(game_map, &area);
+    }
+    for (int sy = sight.y; sy < sight.y + sight.h; sy++)
+    {
+        for (int sx = sight.x; sx < sight.x + sight.w; sx++)
         {
+            const int x = sx + cam.x;
+            const int y = sy + cam.y;
             bool visible = fov_map_is_in_fov(fov_map, x, y);
-            rg_tile* tile = map_get_tile(game_map, x, y);
-            bool is_wall = tile->block_sight;
+            bool is_wall = map_get_fast(game_map, MAP_PLANE_BLOCK_SIGHT, x, y);
+            const rg_tile_type type = map_get_type(game_map, x, y);
+            const bool is_door =
+              type == TILE_DOOR_CLOSED || type == TILE_DOOR_OPEN;
+            const char door = type == TILE_DOOR_CLOSED ? '+' : '\'';
+            char hazard;
+            SDL_Color hazard_color;
             if (visible)
             {
-                tile->explored = true;
-                if (is_wall)
+                map_set_fast(game_map, MAP_PLANE_EXPLORED, x, y, true);
+                map_memory_remember(&data->memory, game_map, x, y);
+                console_fill(console, sx, sy, BLACK);
+                int top = item_stacks_top(&data->item_stacks, x, y);
+                if (top != -1)
                 {
-                    // console_fill(console, x, y, LIGHT_WALL);
-                    console_print(console, x, y, '#', WHITE);
+                    const rg_item_proto* p = item_proto(&items->data[top]);
+                    console_print(console, sx, sy, p->ch, p->color);
                 }
-                else
+                else if (game_hazard_glyph(data, x, y, &hazard, &hazard_color))
                 {
-                    // console_fill(console, x, y, LIGHT_GROUND);
-                    console_print(console, x, y, '.', WHITE);
+                    console_print(console, sx, sy, hazard, hazard_color);
                 }
-            }
-            else if (tile->explored)
-            {
-                if (is_wall)
+                else if (is_door)
+                {
+                    console_print(console, sx, sy, door, WHITE);
+                }
+                else if (is_wall)
                 {
-                    console_print(console, x, y, '#', DARK_GREY);
-                    // console_fill(console, x, y, DARK_WALL);
+                    // console_fill(console, x, y, LIGHT_WALL);
+                    console_print(console, sx, sy, '#', WHITE);
                 }
                 else
                 {
-
-                    // console_fill(console, x, y, DARK_GROUND);
+                    // console_fill(console, x, y, LIGHT_GROUND);
+                    console_print(console, sx, sy, '.', WHITE);
                 }
             }
         }
     }
 
-    for (int i = 0; i < items->len; i++)
-    {
-        const rg_item* e = &items->data[i];
-        if (!e->visible_on_map) continue;
-        if (fov_map_is_in_fov(fov_map, e->x, e->y))
-            console_print(console, e->x, e->y, e->ch, e->color);
-    }
-
-    for (int i = 0; i < entities->len; i++)
+    // Draw in render order passes instead of sorting, entity ids must stay
+    // stable for the spatial grid.
+    for (rg_render_order order = 0; order < RENDER_ORDER_LEN; order++)
     {
-        const rg_entity* e = &entities->data[i];
-        if (fov_map_is_in_fov(fov_map, e->x, e->y))
+        for (int i = 0; i < entities->len; i++)
         {
-            console_print(console, e->x, e->y, e->ch, e->color);
-        }
-        else if (e->type == ENTITY_STAIRS &&
-                 map_get_tile(game_map, e->x, e->y)->explored)
-        {
-            console_fill(console, e->x, e->y, BLACK);
-            console_print(console, e->x, e->y, e->ch, e->color);
+            const rg_entity* e = &entities->data[i];
+            if (entity_render_order(e) != order) continue;
+            if (e->x < cam.x || e->x >= cam.x + view_w || e->y < cam.y ||
+                e->y >= cam.y + view_h)
+                continue;
+            if (fov_map_is_in_fov(fov_map, e->x, e->y))
+            {
+                entity_draw(e, console, cam.x, cam.y);
+            }
+            else if ((entity_type(e) == ENTITY_STAIRS ||
+                      entity_type(e) == ENTITY_STAIRS_UP) &&
+                     map_get(game_map, MAP_PLANE_EXPLORED, e->x, e->y))
+            {
+                console_fill(console, e->x - cam.x, e->y - cam.y, BLACK);
+                entity_draw(e, console, cam.x, cam.y);
+            }
         }
     }
-    console_end(&data->console);
 
     ///-----UI---------------
-    console_begin(&data->panel);
     console_clear(&data->panel, BLACK);
 
     const rg_entity* player = &entities->data[data->player];
@@ -993,7 +1224,6 @@ void game_state_draw(rg_app* app, rg_game_state_data* data)
         console_print_txt(
           &data->panel, data->message_x, y, entry->text, entry->color);
     }
-    console_end(&data->panel);
 
     //-----Menu----------------
     int menu_height;
@@ -1001,38 +1231,30 @@ void game_state_draw(rg_app* app, rg_game_state_data* data)
     int show_char_width = 30, show_char_height = 10;
     if (data->game_state == ST_SHOW_INVENTORY)
     {
-        console_begin(&data->menu);
         console_clear(&data->menu, ((SDL_Color){ 0, 0, 0, 0 }));
         const char* header =
           "Press the key next to an item to use it, or Esc to cancel.";
         inventory_draw(&data->menu,
                        header,
-                       &data->items,
                        &data->inventory,
                        &data->player_equipments,
                        menu_width,
                        &menu_height);
-
-        console_end(&data->menu);
     }
     else if (data->game_state == ST_DROP_INVENTORY)
     {
-        console_begin(&data->menu);
         console_clear(&data->menu, ((SDL_Color){ 0, 0, 0, 0 }));
         const char* header =
           "Press the key next to an item to drop it, or Esc to cancel.";
         inventory_draw(&data->menu,
                        header,
-                       &data->items,
                        &data->inventory,
                        &data->player_equipments,
                        menu_width,
                        &menu_height);
-        console_end(&data->menu);
     }
     else if (data->game_state == ST_LEVEL_UP)
     {
-        console_begin(&data->menu);
         console_clear(&data->menu, ((SDL_Color){ 0, 0, 0, 0 }));
         const char* header = "Level up! Choose a stat to raise:";
         rg_entity* player = &data->entities.data[data->player];
@@ -1061,12 +1283,9 @@ void game_state_draw(rg_app* app, rg_game_state_data* data)
         menu_draw(&data->menu, header, 3, options, 40, &menu_height);
         for (int i = 0; i < 3; i++) free(options[i]);
         free(options);
-
-        console_end(&data->menu);
     }
     else if (data->game_state == ST_SHOW_CHARACTER)
     {
-        console_begin(&data->character_screen);
         console_clear(&data->character_screen, ((SDL_Color){ 0, 0, 0, 0 }));
         console_print_txt(
           &data->character_screen, 0, 1, "Character Information", WHITE);
@@ -1119,94 +1338,126 @@ void game_state_draw(rg_app* app, rg_game_state_data* data)
             console_print_txt(&data->character_screen, 0, 8, buf, WHITE);
             free(buf);
         }
-        console_end(&data->character_screen);
     }
 
     ///-----Screen/Window---------------
-    SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
-    SDL_RenderClear(app->renderer);
-    console_flush(&data->console, 0, 0);
+    const int ts = data->console.tileset->tile_size;
+    for (int i = 0; i < FRAME_LAYER_LEN; i++) f->layers[i].visible = false;
+    f->ended = false;
+    frame_capture(f, FRAME_LAYER_WORLD, &data->console, 0, 0);
+    frame_capture(f, FRAME_LAYER_PANEL, &data->panel, 0, data->panel_y);
     {
-
-        SDL_Rect r = { .x = 0,
-                       .y = data->panel_y * data->panel.tileset->tile_size,
-                       .w = 0,
-                       .h = 0 };
-        SDL_QueryTexture(data->panel.texture, NULL, NULL, &r.w, &r.h);
-
-        SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(app->renderer, &r);
-
-        r.y -= 1;
-        SDL_SetRenderDrawColor(app->renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(app->renderer, &r);
-
-        console_flush(&data->panel, 0, data->panel_y);
+        rg_frame_layer* l = &f->layers[FRAME_LAYER_PANEL];
+        l->backdrop = (SDL_Rect){ .x = 0,
+                                  .y = data->panel_y * ts,
+                                  .w = data->panel.width * ts,
+                                  .h = data->panel.height * ts };
+        l->outline = l->backdrop;
+        l->outline.y -= 1;
     }
 
+    const rg_console* overlay = NULL;
+    int overlay_width, overlay_height;
     if (data->game_state == ST_SHOW_INVENTORY ||
         data->game_state == ST_DROP_INVENTORY ||
         data->game_state == ST_LEVEL_UP)
     {
-        int x =
-          (int)((data->screen_width / (double)2) - (menu_width / (double)2));
-        int y =
-          (int)((data->screen_height / (double)2) - (menu_height / (double)2));
-        SDL_Rect r = { x * data->menu.tileset->tile_size,
-                       y * data->menu.tileset->tile_size,
-                       menu_width * data->menu.tileset->tile_size,
-                       menu_height * data->menu.tileset->tile_size };
-
-        // SDL_SetRenderDrawBlendMode(app->renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(app->renderer, &r);
-        r.x -= 1;
-        r.y -= 1;
-        r.w += 2;
-        r.h += 2;
-        SDL_SetRenderDrawColor(app->renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(app->renderer, &r);
-
-        console_flush(&data->menu, x, y);
-    }
-    if (data->game_state == ST_SHOW_CHARACTER)
+        overlay = &data->menu;
+        overlay_width = menu_width;
+        overlay_height = menu_height;
+    }
+    else if (data->game_state == ST_SHOW_CHARACTER)
+    {
+        overlay = &data->character_screen;
+        overlay_width = show_char_width;
+        overlay_height = show_char_height;
+    }
+    if (overlay != NULL)
     {
         int x = (int)((data->screen_width / (double)2) -
-                      (show_char_width / (double)2));
+                      (overlay_width / (double)2));
         int y = (int)((data->screen_height / (double)2) -
-                      (show_char_height / (double)2));
-        SDL_Rect r = { x * data->menu.tileset->tile_size,
-                       y * data->menu.tileset->tile_size,
-                       show_char_width * data->menu.tileset->tile_size,
-                       show_char_height * data->menu.tileset->tile_size };
-
-        // SDL_SetRenderDrawBlendMode(app->renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(app->renderer, &r);
-        r.x -= 1;
-        r.y -= 1;
-        r.w += 2;
-        r.h += 2;
-        SDL_SetRenderDrawColor(app->renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(app->renderer, &r);
-
-        console_flush(&data->character_screen, x, y);
-    }
-    SDL_RenderPresent(app->renderer);
+                      (overlay_height / (double)2));
+        frame_capture(f, FRAME_LAYER_MENU, overlay, x, y);
+        rg_frame_layer* l = &f->layers[FRAME_LAYER_MENU];
+        l->backdrop = (SDL_Rect){ .x = x * ts,
+                                  .y = y * ts,
+                                  .w = overlay_width * ts,
+                                  .h = overlay_height * ts };
+        l->outline = (SDL_Rect){ .x = l->backdrop.x - 1,
+                                 .y = l->backdrop.y - 1,
+                                 .w = l->backdrop.w + 2,
+                                 .h = l->backdrop.h + 2 };
+    }
 
     data->recompute_fov = false;
 }
 
+// Composes and renders on the calling thread.
+void game_state_draw(rg_app* app, rg_game_state_data* data)
+{
+    game_state_compose(data, &data->frame);
+    frame_view_render(&app->game_view, &data->frame);
+}
+
+// Advances fire, gas and water by a turn and burns whatever stands in fire.
+static void game_hazards_turn(rg_game_state_data* data)
+{
+    if (!hazards_is_active(&data->hazards)) return;
+    if (hazards_step(&data->hazards, &data->game_map))
+        data->recompute_fov = true;
+
+    for (size_t i = 0; i < data->entities.len; i++)
+    {
+        rg_entity* e = &data->entities.data[i];
+        if (e->dead || e->fighter.hp <= 0) continue;
+        const int fire = hazards_get(&data->hazards, HAZARD_FIRE, e->x, e->y);
+        if (fire == 0) continue;
+
+        const int damage = 1 + fire / 16;
+        const char* fmt = "The %s burns for %d hit points.";
+        int len = snprintf(NULL, 0, fmt, entity_name(e), damage);
+        char* buf = malloc(sizeof(char) * (len + 1));
+        snprintf(buf, len + 1, fmt, entity_name(e), damage);
+        rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                    .text = buf,
+                                    .color = ORANGE };
+        turn_logs_push(&data->logs, &entry);
+
+        bool is_dead;
+        int xp;
+        entity_take_damage(e, damage, &data->logs, &is_dead, &xp);
+        if (!is_dead) continue;
+        entity_kill(e, &data->logs);
+        if (i == data->player)
+        {
+            data->game_state = ST_TURN_PLAYER_DEAD;
+            return;
+        }
+    }
+}
+
 void state_enemy_turn(const SDL_Event* event,
                       rg_action* action,
                       rg_game_state_data* data)
 {
+    // Monsters path around each other, the cells they stand on are kept up
+    // to date as they move.
+    rg_cell_bits* blockers = &data->blockers;
+    cell_bits_clear(blockers);
+    for (int i = 0; i < data->entities.len; i++)
+    {
+        const rg_entity* e = &data->entities.data[i];
+        if (entity_blocks(e)) cell_bits_set(blockers, e->x, e->y, true);
+    }
+
     for (int i = 0; i < data->entities.len; i++)
     {
         if (i == data->player) continue;
 
         rg_entity* e = &data->entities.data[i];
         if (e->fighter.hp <= 0) continue;
+        cell_bits_set(blockers, e->x, e->y, false);
 
         rg_entity* player = &data->entities.data[data->player];
 
@@ -1216,9 +1467,14 @@ void state_enemy_turn(const SDL_Event* event,
                            &data->player_equipments,
                            &data->fov_map,
                            &data->game_map,
+                           &data->hazards,
+                           blockers,
                            &data->entities,
                            &data->logs,
+                           rng_stream(&data->rng, RNG_STREAM_AI),
                            &dead_entity);
+        spatial_grid_update(&data->spatial, &data->entities, i);
+        if (entity_blocks(e)) cell_bits_set(blockers, e->x, e->y, true);
         if (dead_entity != NULL)
         {
             entity_kill(dead_entity, &data->logs);
@@ -1229,6 +1485,7 @@ void state_enemy_turn(const SDL_Event* event,
         }
         if (data->game_state == ST_TURN_PLAYER_DEAD) break;
     }
+    if (data->game_state != ST_TURN_PLAYER_DEAD) game_hazards_turn(data);
     if (data->game_state != ST_TURN_PLAYER_DEAD)
         data->game_state = ST_TURN_PLAYER;
 }
@@ -1262,10 +1519,15 @@ void state_player_turn(const SDL_Event* event,
         {
             rg_entity* player = &data->entities.data[data->player];
             rg_entity* e = &data->entities.data[i];
-            if (e->type == ENTITY_STAIRS && e->x == player->x &&
-                e->y == player->y)
+            if (e->x != player->x || e->y != player->y) continue;
+            if (entity_type(e) == ENTITY_STAIRS)
+            {
+                game_change_level(data, data->game_map.level + 1);
+                return;
+            }
+            if (entity_type(e) == ENTITY_STAIRS_UP)
             {
-                game_next_level(data);
+                game_change_level(data, data->game_map.level - 1);
                 return;
             }
         }
@@ -1305,11 +1567,9 @@ void state_inventory_drop_turn(const SDL_Event* event,
     {
     case ACTION_SELECT:
         if (data->prev_state == ST_TURN_PLAYER_DEAD) return;
-        if (data->inventory.len == 0) return;
-        if (data->inventory.len < action->index) return;
-        ASSERT_M(action->index >= 0);
-        const size_t idx = data->inventory.data[action->index];
-        rg_item* item = &data->items.data[idx];
+        if (action->index < 0) return;
+        rg_item* item = inventory_get(&data->inventory, action->index);
+        if (item == NULL) return;
 
         if (data->player_equipments.main_hand == item ||
             data->player_equipments.off_hand == item)
@@ -1317,15 +1577,22 @@ void state_inventory_drop_turn(const SDL_Event* event,
               &data->player_equipments, item, NULL, NULL, NULL);
         {
             const char* fmt = "You dropped the %s";
-            int len = snprintf(NULL, 0, fmt, item->name);
+            int len = snprintf(NULL, 0, fmt, item_proto(item)->name);
             char* buf = malloc(sizeof(char) * (len + 1));
-            snprintf(buf, len + 1, fmt, item->name);
+            snprintf(buf, len + 1, fmt, item_proto(item)->name);
             rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                         .text = buf,
                                         .color = YELLOW };
             turn_logs_push(&data->logs, &entry);
         }
-        inventory_remove_item(&data->inventory, &data->items, item);
+        {
+            rg_entity* player = &data->entities.data[data->player];
+            rg_item dropped = *item;
+            dropped.x = player->x;
+            dropped.y = player->y;
+            item_stacks_add(&data->item_stacks, &data->items, &dropped);
+        }
+        inventory_remove_item(&data->inventory, item);
         break;
     case ACTION_ESCAPE:
         data->game_state = data->prev_state;
@@ -1350,11 +1617,9 @@ void state_inventory_turn(const SDL_Event* event,
     {
     case ACTION_SELECT:
         if (data->prev_state == ST_TURN_PLAYER_DEAD) return;
-        if (data->inventory.len == 0) return;
-        if (data->inventory.len < action->index) return;
-        ASSERT_M(action->index >= 0);
-        const size_t idx = data->inventory.data[action->index];
-        rg_item* item = &data->items.data[idx];
+        if (action->index < 0) return;
+        rg_item* item = inventory_get(&data->inventory, action->index);
+        if (item == NULL) return;
 
         {
             rg_entity* player = &data->entities.data[data->player];
@@ -1362,7 +1627,7 @@ void state_inventory_turn(const SDL_Event* event,
             item_use(item, player, data, &data->logs, &consumed);
             if (consumed)
             {
-                inventory_remove_item(&data->inventory, &data->items, item);
+                inventory_remove_item(&data->inventory, item);
                 data->game_state = ST_TURN_ENEMY;
             }
         }
@@ -1406,7 +1671,7 @@ void state_targeting_turn(const SDL_Event* event,
             item_use(item, NULL, data, &data->logs, &consumed);
             if (consumed)
             {
-                inventory_remove_item(&data->inventory, &data->items, item);
+                inventory_remove_item(&data->inventory, item);
                 data->game_state = ST_TURN_ENEMY;
             }
         }
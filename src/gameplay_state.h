@@ -2,6 +2,7 @@
 #define GAMEPLAY_STATE
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <SDL.h>
 
@@ -9,8 +10,16 @@
 #include "entity.h"
 #include "events.h"
 #include "fov.h"
+#include "frame.h"
 #include "game_map.h"
+#include "hazards.h"
 #include "inventory.h"
+#include "item_stacks.h"
+#include "level.h"
+#include "level_cache.h"
+#include "map_memory.h"
+#include "rng.h"
+#include "spatial.h"
 #include "terminal.h"
 #include "tileset.h"
 #include "turn_log.h"
@@ -49,6 +58,8 @@ typedef struct rg_game_state_data
     int message_height;
     int map_width;
     int map_height;
+    int view_width;
+    int view_height;
     int room_max_size;
     int room_min_size;
     int max_rooms;
@@ -65,18 +76,29 @@ typedef struct rg_game_state_data
     rg_console menu;
     rg_console character_screen;
     rg_entity_array entities;
+    rg_spatial_grid spatial;
     rg_items items;
+    rg_item_stacks item_stacks;
     rg_entity_id player;
     rg_player_level player_level;
     struct rg_player_equipments player_equipments;
     rg_map game_map;
     rg_fov_map fov_map;
+    rg_hazards hazards; // fire, gas and water of the current level
+    rg_cell_bits blockers; // blocking entities, kept during the enemy turn
+    rg_map_memory memory; // remembered terrain, drawn under the console
+    rg_level_pregen pregen;
+    rg_level_cache level_cache; // levels the player has left
+    rg_rng_streams rng;
     bool recompute_fov;
+    uint32_t fov_generation; // map generation the fov was computed at
     rg_game_state game_state;
     rg_game_state prev_state;
     rg_inventory inventory;
     rg_turn_logs logs;
     SDL_Point mouse_position;
+    SDL_Point camera; // map position of the top left console cell
+    rg_frame frame;   // composed by game_state_draw
 } rg_game_state_data;
 
 bool game_state_load_game(rg_game_state_data* data, struct rg_app* app);
@@ -86,7 +108,12 @@ void game_state_destroy(rg_game_state_data* data);
 void game_state_update(struct rg_app* app,
                        SDL_Event* event,
                        rg_game_state_data* data);
+bool game_state_handle_event(struct rg_app* app,
+                             SDL_Event* event,
+                             rg_game_state_data* data);
+void game_state_compose(rg_game_state_data* data, rg_frame* f);
 void game_state_draw(struct rg_app* app, rg_game_state_data* data);
+bool game_state_is_busy(const rg_game_state_data* data);
 
 void state_player_turn(const SDL_Event* event,
                        rg_action* action,
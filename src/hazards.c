@@ -0,0 +1,337 @@
+#include "hazards.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+#define FIRE_DECAY 2       // lost every turn
+#define FIRE_FALLOFF 4     // lost spreading to a neighbour
+#define FIRE_SMOKE_SHIFT 3 // a fire of f gives off f >> 3 gas
+#define GAS_DECAY 1
+
+static const uint8_t zero_row[HAZARD_BLOCK_SIZE];
+
+static int field_index(const rg_hazards* h, int x, int y)
+{
+    return (y + 1) * h->stride + x + 1;
+}
+
+static int block_of(const rg_hazards* h, int x, int y)
+{
+    const int bx = x >> HAZARD_BLOCK_SHIFT;
+    const int by = y >> HAZARD_BLOCK_SHIFT;
+    return bx + by * h->blocks_wide;
+}
+
+void hazards_create(rg_hazards* h, int width, int height)
+{
+    memset(h, 0, sizeof(*h));
+    h->width = width;
+    h->height = height;
+    h->stride = width + 2;
+    h->blocks_wide = (width + HAZARD_BLOCK_SIZE - 1) >> HAZARD_BLOCK_SHIFT;
+    h->blocks_high = (height + HAZARD_BLOCK_SIZE - 1) >> HAZARD_BLOCK_SHIFT;
+    const int blocks = h->blocks_wide * h->blocks_high;
+    for (int k = 0; k < HAZARD_LEN; k++)
+    {
+        rg_hazard_field* f = &h->fields[k];
+        f->active = calloc(blocks, 1);
+        f->next_active = calloc(blocks, 1);
+        ASSERT_M(f->active != NULL && f->next_active != NULL);
+    }
+    h->touched = calloc(blocks, 1);
+    ASSERT_M(h->touched != NULL);
+    cell_bits_create(&h->opaque, width, height);
+    cell_bits_create(&h->impassable, width, height);
+}
+
+void hazards_destroy(rg_hazards* h)
+{
+    for (int k = 0; k < HAZARD_LEN; k++)
+    {
+        rg_hazard_field* f = &h->fields[k];
+        free(f->cur);
+        free(f->next);
+        free(f->active);
+        free(f->next_active);
+    }
+    free(h->touched);
+    cell_bits_destroy(&h->opaque);
+    cell_bits_destroy(&h->impassable);
+    memset(h, 0, sizeof(*h));
+}
+
+// Buffers are only allocated once a field is used, most levels never see
+// water.
+static void field_ensure(const rg_hazards* h, rg_hazard_field* f)
+{
+    if (f->cur != NULL) return;
+    const size_t len = (size_t)h->stride * (h->height + 2);
+    f->cur = calloc(len, 1);
+    f->next = calloc(len, 1);
+    ASSERT_M(f->cur != NULL && f->next != NULL);
+}
+
+void hazards_add(
+  rg_hazards* h, rg_hazard_kind kind, int x, int y, int amount)
+{
+    ASSERT_M(kind < HAZARD_LEN);
+    ASSERT_M(x >= 0 && x < h->width && y >= 0 && y < h->height);
+    if (amount <= 0) return;
+    rg_hazard_field* f = &h->fields[kind];
+    field_ensure(h, f);
+    uint8_t* cell = &f->cur[field_index(h, x, y)];
+    *cell = (uint8_t)MIN(255, *cell + amount);
+    const int b = block_of(h, x, y);
+    if (!f->active[b])
+    {
+        f->active[b] = 1;
+        f->active_len++;
+    }
+}
+
+uint8_t hazards_get(const rg_hazards* h, rg_hazard_kind kind, int x, int y)
+{
+    const rg_hazard_field* f = &h->fields[kind];
+    return f->cur != NULL ? f->cur[field_index(h, x, y)] : 0;
+}
+
+bool hazards_is_active(const rg_hazards* h)
+{
+    for (int k = 0; k < HAZARD_LEN; k++)
+    {
+        if (h->fields[k].active_len > 0) return true;
+    }
+    return false;
+}
+
+// Blocked bits of one block row, `c` is the map chunk holding the block.
+// Blocks never straddle a chunk.
+static uint32_t blocked_bits(const rg_map_chunk* c, int x0, int y)
+{
+    const uint64_t row = c->planes[MAP_PLANE_BLOCKED][y & MAP_CHUNK_MASK];
+    return (uint32_t)(row >> (x0 & MAP_CHUNK_MASK)) & 0xffff;
+}
+
+// The row kernels below have no data dependent branches so the compiler can
+// vectorize them. `row` points at the first cell, the zero border makes
+// row[-1] and row[n] readable.
+static void diffuse_row(uint8_t* dst,
+                        const uint8_t* up,
+                        const uint8_t* row,
+                        const uint8_t* down,
+                        uint32_t blocked,
+                        int n,
+                        int decay)
+{
+    for (int i = 0; i < n; i++)
+    {
+        const int sum = 4 * row[i] + row[i - 1] + row[i + 1] + up[i] + down[i];
+        const int v = MAX((sum >> 3) - decay, 0);
+        dst[i] = (uint8_t)(((blocked >> i) & 1) ? 0 : v);
+    }
+}
+
+static void fire_row(uint8_t* dst,
+                     const uint8_t* up,
+                     const uint8_t* row,
+                     const uint8_t* down,
+                     const uint8_t* water,
+                     uint32_t blocked,
+                     int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        const int spread =
+          MAX(MAX(row[i - 1], row[i + 1]), MAX(up[i], down[i]));
+        const int v =
+          MAX(MAX(row[i] - FIRE_DECAY, spread - FIRE_FALLOFF), 0);
+        dst[i] = (uint8_t)((((blocked >> i) & 1) || water[i]) ? 0 : v);
+    }
+}
+
+static void smoke_row(uint8_t* dst, const uint8_t* fire, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = (uint8_t)MIN(255, dst[i] + (fire[i] >> FIRE_SMOKE_SHIFT));
+}
+
+static bool field_near_active(const rg_hazards* h,
+                              const rg_hazard_field* f,
+                              int bx,
+                              int by)
+{
+    for (int y = MAX(0, by - 1); y <= MIN(h->blocks_high - 1, by + 1); y++)
+    {
+        for (int x = MAX(0, bx - 1); x <= MIN(h->blocks_wide - 1, bx + 1); x++)
+        {
+            if (f->active[x + y * h->blocks_wide]) return true;
+        }
+    }
+    return false;
+}
+
+// Moves a field one turn ahead. Only blocks next to active ones are updated,
+// plus the ones where `source` is active. `other` is the field the kernel
+// reads along, water for fire and fire for gas.
+static void field_step(rg_hazards* h,
+                       rg_map* m,
+                       rg_hazard_kind kind,
+                       const rg_hazard_field* other,
+                       const rg_hazard_field* source)
+{
+    rg_hazard_field* f = &h->fields[kind];
+    if (source != NULL && source->active_len > 0) field_ensure(h, f);
+    if (f->cur == NULL) return;
+    const bool has_other = other != NULL && other->cur != NULL;
+
+    int active_len = 0;
+    for (int by = 0; by < h->blocks_high; by++)
+    {
+        for (int bx = 0; bx < h->blocks_wide; bx++)
+        {
+            const int b = bx + by * h->blocks_wide;
+            f->next_active[b] = 0;
+            if (!field_near_active(h, f, bx, by) &&
+                !(source != NULL && source->active[b]))
+                continue;
+            h->touched[b] = 1;
+
+            const int x0 = bx << HAZARD_BLOCK_SHIFT;
+            const int y0 = by << HAZARD_BLOCK_SHIFT;
+            const int n = MIN(HAZARD_BLOCK_SIZE, h->width - x0);
+            const int y1 = MIN(y0 + HAZARD_BLOCK_SIZE, h->height);
+            const rg_map_chunk* chunk = map_chunk_fetch(
+              m, x0 >> MAP_CHUNK_SHIFT, y0 >> MAP_CHUNK_SHIFT);
+            uint8_t any = 0;
+            for (int y = y0; y < y1; y++)
+            {
+                const int i = field_index(h, x0, y);
+                const uint8_t* row = &f->cur[i];
+                const uint8_t* with = has_other ? &other->cur[i] : zero_row;
+                uint8_t* dst = &f->next[i];
+                const uint32_t blocked = blocked_bits(chunk, x0, y);
+                switch (kind)
+                {
+                case HAZARD_FIRE:
+                    fire_row(dst,
+                             row - h->stride,
+                             row,
+                             row + h->stride,
+                             with,
+                             blocked,
+                             n);
+                    break;
+                case HAZARD_GAS:
+                    diffuse_row(dst,
+                                row - h->stride,
+                                row,
+                                row + h->stride,
+                                blocked,
+                                n,
+                                GAS_DECAY);
+                    smoke_row(dst, with, n);
+                    break;
+                default:
+                    diffuse_row(dst,
+                                row - h->stride,
+                                row,
+                                row + h->stride,
+                                blocked,
+                                n,
+                                0);
+                    break;
+                }
+                for (int k = 0; k < n; k++) any |= dst[k];
+            }
+            if (any)
+            {
+                f->next_active[b] = 1;
+                active_len++;
+            }
+        }
+    }
+
+    // Only the old active blocks can hold anything, clearing them leaves a
+    // zero spare buffer.
+    for (int b = 0; b < h->blocks_wide * h->blocks_high; b++)
+    {
+        if (!f->active[b]) continue;
+        const int x0 = (b % h->blocks_wide) << HAZARD_BLOCK_SHIFT;
+        const int y0 = (b / h->blocks_wide) << HAZARD_BLOCK_SHIFT;
+        const int n = MIN(HAZARD_BLOCK_SIZE, h->width - x0);
+        const int y1 = MIN(y0 + HAZARD_BLOCK_SIZE, h->height);
+        for (int y = y0; y < y1; y++)
+            memset(&f->cur[field_index(h, x0, y)], 0, n);
+    }
+
+    uint8_t* cells = f->cur;
+    f->cur = f->next;
+    f->next = cells;
+    uint8_t* active = f->active;
+    f->active = f->next_active;
+    f->next_active = active;
+    f->active_len = active_len;
+}
+
+// Rebuilds the sight and movement bits of the updated blocks. Returns true
+// when any cell changed transparency.
+static bool hazards_publish(rg_hazards* h)
+{
+    const rg_hazard_field* fire = &h->fields[HAZARD_FIRE];
+    const rg_hazard_field* gas = &h->fields[HAZARD_GAS];
+    const rg_hazard_field* water = &h->fields[HAZARD_WATER];
+    bool sight_changed = false;
+    for (int b = 0; b < h->blocks_wide * h->blocks_high; b++)
+    {
+        if (!h->touched[b]) continue;
+        h->touched[b] = 0;
+        const int x0 = (b % h->blocks_wide) << HAZARD_BLOCK_SHIFT;
+        const int y0 = (b / h->blocks_wide) << HAZARD_BLOCK_SHIFT;
+        const int n = MIN(HAZARD_BLOCK_SIZE, h->width - x0);
+        const int y1 = MIN(y0 + HAZARD_BLOCK_SIZE, h->height);
+        const int shift = x0 & 63;
+        const uint64_t mask = 0xffffull << shift;
+        for (int y = y0; y < y1; y++)
+        {
+            const int i = field_index(h, x0, y);
+            uint64_t opaque = 0;
+            uint64_t impassable = 0;
+            for (int k = 0; k < n; k++)
+            {
+                const bool thick =
+                  gas->cur != NULL && gas->cur[i + k] >= HAZARD_GAS_OPAQUE;
+                const bool burning = fire->cur != NULL && fire->cur[i + k];
+                const bool deep = water->cur != NULL &&
+                                  water->cur[i + k] >= HAZARD_WATER_DEEP;
+                opaque |= (uint64_t)thick << k;
+                impassable |= (uint64_t)(burning || deep) << k;
+            }
+            uint64_t* o = &h->opaque.bits[y * h->opaque.stride + (x0 >> 6)];
+            uint64_t* p =
+              &h->impassable.bits[y * h->impassable.stride + (x0 >> 6)];
+            const uint64_t next = (*o & ~mask) | (opaque << shift);
+            sight_changed |= next != *o;
+            *o = next;
+            *p = (*p & ~mask) | (impassable << shift);
+        }
+    }
+    return sight_changed;
+}
+
+// Advances all fields by one turn, water first so it puts out fire in the
+// same turn and fire before gas so its smoke shows up right away. Returns
+// true when the field of view has to be recomputed.
+bool hazards_step(rg_hazards* h, rg_map* m)
+{
+    if (!hazards_is_active(h)) return false;
+    field_step(h, m, HAZARD_WATER, NULL, NULL);
+    field_step(h, m, HAZARD_FIRE, &h->fields[HAZARD_WATER], NULL);
+    field_step(h,
+               m,
+               HAZARD_GAS,
+               &h->fields[HAZARD_FIRE],
+               &h->fields[HAZARD_FIRE]);
+    return hazards_publish(h);
+}
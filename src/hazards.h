@@ -0,0 +1,61 @@
+#ifndef HAZARDS_H
+#define HAZARDS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game_map.h"
+
+// Fields are updated in square blocks, only around the ones holding anything.
+#define HAZARD_BLOCK_SHIFT 4
+#define HAZARD_BLOCK_SIZE (1 << HAZARD_BLOCK_SHIFT)
+
+// Gas at least this thick blocks sight.
+#define HAZARD_GAS_OPAQUE 24
+// Water at least this deep is not walked through by monsters.
+#define HAZARD_WATER_DEEP 96
+
+typedef enum rg_hazard_kind
+{
+    HAZARD_FIRE,  // burns out, spreads to its neighbours, smokes
+    HAZARD_GAS,   // diffuses and thins out
+    HAZARD_WATER, // flows out evenly, puts out fire
+
+    HAZARD_LEN,
+} rg_hazard_kind;
+
+// One intensity per cell, double buffered. Both buffers have a zero border so
+// the update reads neighbours without bounds checks. Cells outside the active
+// blocks are zero, and the spare buffer is all zero between steps.
+typedef struct rg_hazard_field
+{
+    uint8_t* cur;    // NULL until something is added
+    uint8_t* next;
+    uint8_t* active; // per block
+    uint8_t* next_active;
+    int active_len;
+} rg_hazard_field;
+
+typedef struct rg_hazards
+{
+    int width;
+    int height;
+    int stride; // padded row length of the fields
+    int blocks_wide;
+    int blocks_high;
+    rg_hazard_field fields[HAZARD_LEN];
+    uint8_t* touched;        // per block, scratch for the step
+    rg_cell_bits opaque;     // thick gas
+    rg_cell_bits impassable; // fire and deep water
+} rg_hazards;
+
+void hazards_create(rg_hazards* h, int width, int height);
+void hazards_destroy(rg_hazards* h);
+
+void hazards_add(
+  rg_hazards* h, rg_hazard_kind kind, int x, int y, int amount);
+uint8_t hazards_get(const rg_hazards* h, rg_hazard_kind kind, int x, int y);
+bool hazards_is_active(const rg_hazards* h);
+bool hazards_step(rg_hazards* h, rg_map* m);
+
+#endif
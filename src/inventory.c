@@ -14,23 +14,29 @@ void inventory_create(rg_inventory* i, size_t capacity)
     memset(i, 0, sizeof(rg_inventory));
     i->capacity = capacity;
     i->len = 0;
-    i->data = malloc(sizeof(rg_inventory) * i->capacity);
+    i->data = malloc(sizeof(*i->data) * i->capacity);
     ASSERT_M(i->data != NULL);
+    i->slots = calloc(i->capacity, sizeof(*i->slots));
+    ASSERT_M(i->slots != NULL);
+    i->slot_used = calloc(i->capacity, sizeof(*i->slot_used));
+    ASSERT_M(i->slot_used != NULL);
 }
 
 void inventory_destroy(rg_inventory* i)
 {
     if (i == NULL) return;
     if (i->data != NULL) free(i->data);
+    if (i->slots != NULL) free(i->slots);
+    if (i->slot_used != NULL) free(i->slot_used);
 }
 
-void inventory_add_item(rg_inventory* inventory,
-                        rg_items* items,
-                        size_t item_idx,
-                        rg_turn_logs* logs)
+rg_item* inventory_add_item(rg_inventory* inventory,
+                            const rg_item* item,
+                            rg_turn_logs* logs)
 {
-    if (inventory->len >= inventory->capacity && logs != NULL)
+    if (inventory->len >= inventory->capacity)
     {
+        if (logs == NULL) return NULL;
         const char* fmt = "You cannot carry any more, your inventory is full";
 
         int len = snprintf(NULL, 0, fmt);
@@ -41,78 +47,66 @@ void inventory_add_item(rg_inventory* inventory,
                                     .color = YELLOW };
         turn_logs_push(logs, &entry);
 
-        return;
+        return NULL;
     }
 
-    rg_item* item = &items->data[item_idx];
-    item->visible_on_map = false;
+    size_t slot = 0;
+    while (inventory->slot_used[slot]) slot++;
+    ASSERT_M(slot < inventory->capacity);
+    inventory->slot_used[slot] = true;
+    inventory->slots[slot] = *item;
     if (logs != NULL)
     {
         const char* fmt = "You pick up the %s!";
-        int len = snprintf(NULL, 0, fmt, item->name);
+        int len = snprintf(NULL, 0, fmt, item_proto(item)->name);
         char* buf = malloc(sizeof(char) * (len + 1));
-        snprintf(buf, len, fmt, item->name);
+        snprintf(buf, len, fmt, item_proto(item)->name);
         rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                     .text = buf,
                                     .color = BLUE };
         turn_logs_push(logs, &entry);
     }
-    for (int i = 0; i < inventory->len; i++)
-        ASSERT_M(inventory->data[i] != item_idx);
 
-    ARRAY_PUSH(inventory, item_idx);
+    ARRAY_PUSH(inventory, slot);
+    return &inventory->slots[slot];
 }
 
-void inventory_remove_item(rg_inventory* inventory,
-                           rg_items* items,
-                           rg_item* item)
+void inventory_remove_item(rg_inventory* inventory, rg_item* item)
 {
-    int item_idx = -1;
-    for (size_t i = 0; i < items->len; i++)
-    {
-        if (&items->data[i] == item)
-        {
-            item_idx = (int)i;
-            break;
-        }
-    }
-    if (item_idx == -1)
+    if (item < inventory->slots ||
+        item >= inventory->slots + inventory->capacity)
     {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "invalid remove item");
         return;
     }
+    size_t slot = item - inventory->slots;
     int inv_itex = -1;
-    size_t idx = item_idx;
     for (int i = 0; i < inventory->len; i++)
     {
-        if (inventory->data[i] == idx)
+        if (inventory->data[i] == slot)
         {
             inv_itex = i;
             break;
         }
     }
     if (inv_itex == -1) return;
-    if (inventory->len == 1)
-    {
-        inventory->len = 0;
-        return;
-    }
-    if (inv_itex == inventory->len - 1)
-    {
-        inventory->len--;
-        return;
-    }
+    inventory->slot_used[slot] = false;
     size_t* dest = inventory->data + inv_itex;
     size_t* src = inventory->data + inv_itex + 1;
     size_t sz = inventory->len - inv_itex - 1;
-    memmove(dest, src, sz * sizeof(dest));
+    memmove(dest, src, sz * sizeof(*dest));
 
     inventory->len--;
 }
 
+rg_item* inventory_get(rg_inventory* inventory, size_t index)
+{
+    if (index >= inventory->len) return NULL;
+    return &inventory->slots[inventory->data[index]];
+}
+
 void inventory_draw(rg_console* c,
                     const char* header,
-                    rg_items* items,
                     rg_inventory* inventory,
                     rg_player_equipments* player_equipments,
                     int width,
@@ -128,28 +122,27 @@ void inventory_draw(rg_console* c,
         char** options = malloc(sizeof(char*) * inventory->len);
         for (int i = 0; i < inventory->len; i++)
         {
-            size_t idx = inventory->data[i];
-            rg_item* item = &items->data[idx];
+            rg_item* item = inventory_get(inventory, i);
 
             if (player_equipments->main_hand == item)
             {
                 const char* fmt = "%s (on main hand)";
-                int len = snprintf(NULL, 0, fmt, item->name);
+                int len = snprintf(NULL, 0, fmt, item_proto(item)->name);
                 options[i] = malloc(sizeof(char) * (len + 1));
-                snprintf(options[i], len + 1, fmt, item->name);
+                snprintf(options[i], len + 1, fmt, item_proto(item)->name);
                 options[i][len] = '\0';
             }
             else if (player_equipments->off_hand == item)
             {
                 const char* fmt = "%s (on off hand)";
-                int len = snprintf(NULL, 0, fmt, item->name);
+                int len = snprintf(NULL, 0, fmt, item_proto(item)->name);
                 options[i] = malloc(sizeof(char) * (len + 1));
-                snprintf(options[i], len + 1, fmt, item->name);
+                snprintf(options[i], len + 1, fmt, item_proto(item)->name);
                 options[i][len] = '\0';
             }
             else
             {
-                options[i] = strdup(item->name);
+                options[i] = strdup(item_proto(item)->name);
             }
         }
         menu_draw(c, header, (int)inventory->len, options, width, height);
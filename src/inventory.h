@@ -1,6 +1,7 @@
 #ifndef INVENTORY_H
 #define INVENTORY_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "console.h"
@@ -9,26 +10,27 @@
 #include "items.h"
 #include "turn_log.h"
 
+// Items held by the player live here, outside the world item list. Slots
+// never move, so pointers into them (equipment, targeting) stay valid.
 typedef struct rg_inventory
 {
     size_t capacity;
     size_t len;
-    size_t* data;
+    size_t* data; // slot index per menu entry
+    rg_item* slots;
+    bool* slot_used;
 } rg_inventory;
 
 void inventory_create(rg_inventory* i, size_t capacity);
 void inventory_destroy(rg_inventory* i);
-void inventory_add_item(rg_inventory* inventory,
-                        rg_items* items,
-                        size_t item_idx,
-                        rg_turn_logs* logs);
-void inventory_remove_item(rg_inventory* inventory,
-                           rg_items* items,
-                           rg_item* item);
+rg_item* inventory_add_item(rg_inventory* inventory,
+                            const rg_item* item,
+                            rg_turn_logs* logs);
+void inventory_remove_item(rg_inventory* inventory, rg_item* item);
+rg_item* inventory_get(rg_inventory* inventory, size_t index);
 
 void inventory_draw(rg_console* c,
                     const char* header,
-                    rg_items* items,
                     rg_inventory* inventory,
                     rg_player_equipments* player_equipments,
                     int width,
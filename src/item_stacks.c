@@ -0,0 +1,131 @@
+#include "item_stacks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "types.h"
+
+static int* cell_head(rg_item_stacks* s, int x, int y)
+{
+    ASSERT_M(x >= 0 && x < s->width && y >= 0 && y < s->height);
+    return &s->heads[x + y * s->width];
+}
+
+static void stacks_reserve(rg_item_stacks* s, size_t len)
+{
+    if (len <= s->capacity) return;
+    size_t capacity = s->capacity == 0 ? 16 : s->capacity;
+    while (capacity < len) capacity *= 2;
+    s->next = realloc(s->next, sizeof(*s->next) * capacity);
+    ASSERT_M(s->next != NULL);
+    s->capacity = capacity;
+}
+
+static void stacks_link(rg_item_stacks* s, rg_items* items, size_t idx)
+{
+    stacks_reserve(s, idx + 1);
+    int* head = cell_head(s, items->data[idx].x, items->data[idx].y);
+    s->next[idx] = *head;
+    *head = (int)idx;
+}
+
+static void stacks_unlink(rg_item_stacks* s, rg_items* items, size_t idx)
+{
+    int* link = cell_head(s, items->data[idx].x, items->data[idx].y);
+    while (*link != -1)
+    {
+        if (*link == (int)idx)
+        {
+            *link = s->next[idx];
+            return;
+        }
+        link = &s->next[*link];
+    }
+    ASSERT_M(false); // item was not indexed
+}
+
+// Points whatever link referenced item `from` at item `to` instead, keeping
+// its position in the stack.
+static void stacks_relabel(rg_item_stacks* s,
+                           rg_items* items,
+                           size_t from,
+                           size_t to)
+{
+    int* link = cell_head(s, items->data[from].x, items->data[from].y);
+    while (*link != (int)from)
+    {
+        ASSERT_M(*link != -1);
+        link = &s->next[*link];
+    }
+    *link = (int)to;
+    s->next[to] = s->next[from];
+}
+
+void item_stacks_create(rg_item_stacks* s, int width, int height)
+{
+    memset(s, 0, sizeof(*s));
+    s->width = width;
+    s->height = height;
+    s->heads = malloc(sizeof(*s->heads) * width * height);
+    ASSERT_M(s->heads != NULL);
+    for (int i = 0; i < width * height; i++) s->heads[i] = -1;
+}
+
+void item_stacks_destroy(rg_item_stacks* s)
+{
+    if (s == NULL) return;
+    free(s->heads);
+    free(s->next);
+    memset(s, 0, sizeof(*s));
+}
+
+void item_stacks_build(rg_item_stacks* s, rg_items* items)
+{
+    for (int i = 0; i < s->width * s->height; i++) s->heads[i] = -1;
+    for (size_t i = 0; i < items->len; i++) stacks_link(s, items, i);
+}
+
+void item_stacks_add(rg_item_stacks* s, rg_items* items, const rg_item* item)
+{
+    ARRAY_PUSH(items, *item);
+    stacks_link(s, items, items->len - 1);
+}
+
+// Indexes an item that was appended to `items` directly.
+void item_stacks_link(rg_item_stacks* s, rg_items* items, size_t idx)
+{
+    ASSERT_M(idx < items->len);
+    stacks_link(s, items, idx);
+}
+
+void item_stacks_take(rg_item_stacks* s,
+                      rg_items* items,
+                      size_t idx,
+                      rg_item* out)
+{
+    ASSERT_M(idx < items->len);
+    stacks_unlink(s, items, idx);
+    if (out != NULL) *out = items->data[idx];
+
+    // Swap the last item into the hole so the floor list stays dense.
+    size_t last = items->len - 1;
+    if (idx != last)
+    {
+        stacks_relabel(s, items, last, idx);
+        items->data[idx] = items->data[last];
+    }
+    items->len--;
+}
+
+int item_stacks_top(rg_item_stacks* s, int x, int y)
+{
+    if (x < 0 || x >= s->width || y < 0 || y >= s->height) return -1;
+    return s->heads[x + y * s->width];
+}
+
+int item_stacks_next(rg_item_stacks* s, int idx)
+{
+    ASSERT_M(idx >= 0 && (size_t)idx < s->capacity);
+    return s->next[idx];
+}
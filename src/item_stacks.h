@@ -0,0 +1,33 @@
+#ifndef ITEM_STACKS_H
+#define ITEM_STACKS_H
+
+#include <stddef.h>
+
+#include "items.h"
+
+// Per-cell index over the items lying on the floor. Every cell holds an
+// intrusive singly linked list of item indices, newest item on top.
+typedef struct rg_item_stacks
+{
+    int width;
+    int height;
+    int* heads; // top item per cell, -1 when the cell is empty
+    size_t capacity;
+    int* next; // next item below, per item index
+} rg_item_stacks;
+
+void item_stacks_create(rg_item_stacks* s, int width, int height);
+void item_stacks_destroy(rg_item_stacks* s);
+void item_stacks_build(rg_item_stacks* s, rg_items* items);
+
+void item_stacks_add(rg_item_stacks* s, rg_items* items, const rg_item* item);
+void item_stacks_link(rg_item_stacks* s, rg_items* items, size_t idx);
+void item_stacks_take(rg_item_stacks* s,
+                      rg_items* items,
+                      size_t idx,
+                      rg_item* out);
+
+int item_stacks_top(rg_item_stacks* s, int x, int y);
+int item_stacks_next(rg_item_stacks* s, int idx);
+
+#endif
@@ -5,13 +5,113 @@
 #include "color.h"
 #include "gameplay_state.h"
 
+const rg_item_proto item_prototypes[ITEM_PROTO_LEN] = {
+    [ITEM_PROTO_HEALING_POTION] = {
+      .name = "Healing Potion",
+      .ch = '!',
+      .color = LIGHTEST_VIOLET_INIT,
+      .type = ITEM_POTION_HEAL,
+      .heal = { .amount = 40 },
+    },
+    [ITEM_PROTO_LIGHTNING_SCROLL] = {
+      .name = "Lightning Scroll",
+      .ch = '#',
+      .color = YELLOW_INIT,
+      .type = ITEM_LIGHTNING,
+      .lightning = { .damage = 40, .maximum_range = 5 },
+    },
+    [ITEM_PROTO_FIREBALL_SCROLL] = {
+      .name = "Fireball Scroll",
+      .ch = '*',
+      .color = FLAME_INIT,
+      .type = ITEM_FIRE_BALL,
+      .fireball = {
+        .damage = 25,
+        .radius = 3,
+        .fire = 24,
+        .targeting_msg = "Left-click a target tile for the fireball, or "
+                         "right-click to cancel.",
+        .targeting_msg_color = CYAN_INIT,
+      },
+    },
+    [ITEM_PROTO_CONFUSION_SCROLL] = {
+      .name = "Confusion Scroll",
+      .ch = '#',
+      .color = LIGHT_PINK_INIT,
+      .type = ITEM_CAST_CONFUSE,
+      .confuse = {
+        .duration = 10,
+        .targeting_msg = "Left-click an enemy to confuse it, or right-click "
+                         "to cancel.",
+        .targeting_msg_color = CYAN_INIT,
+      },
+    },
+    [ITEM_PROTO_SWORD] = {
+      .name = "Sword",
+      .ch = '/',
+      .color = SKY_INIT,
+      .type = ITEM_EQUIPMENT,
+      .equipable = { .slot = EQUIPMENT_SLOT_MAIN_HAND, .power_bonus = 3 },
+    },
+    [ITEM_PROTO_SHIELD] = {
+      .name = "Shield",
+      .ch = '[',
+      .color = DARKER_ORANGE_INIT,
+      .type = ITEM_EQUIPMENT,
+      .equipable = { .slot = EQUIPMENT_SLOT_OFF_HAND, .defense_bonus = 1 },
+    },
+    [ITEM_PROTO_DAGGER] = {
+      .name = "Dagger",
+      .ch = '-',
+      .color = SKY_INIT,
+      .type = ITEM_EQUIPMENT,
+      .equipable = { .slot = EQUIPMENT_SLOT_MAIN_HAND, .power_bonus = 2 },
+    },
+    [ITEM_PROTO_FOG_SCROLL] = {
+      .name = "Fog Scroll",
+      .ch = '#',
+      .color = LIGHT_GREY_INIT,
+      .type = ITEM_HAZARD_CLOUD,
+      .cloud = {
+        .hazard = HAZARD_GAS,
+        .amount = 96,
+        .radius = 3,
+        .msg = "A thick fog rolls out.",
+        .targeting_msg = "Left-click a target tile for the fog, or "
+                         "right-click to cancel.",
+        .targeting_msg_color = CYAN_INIT,
+      },
+    },
+    [ITEM_PROTO_FLOOD_SCROLL] = {
+      .name = "Flood Scroll",
+      .ch = '#',
+      .color = SKY_INIT,
+      .type = ITEM_HAZARD_CLOUD,
+      .cloud = {
+        .hazard = HAZARD_WATER,
+        .amount = 255,
+        .radius = 2,
+        .msg = "Water gushes out, flooding the area!",
+        .targeting_msg = "Left-click a target tile to flood, or "
+                         "right-click to cancel.",
+        .targeting_msg_color = CYAN_INIT,
+      },
+    },
+};
+
+const rg_item_proto* item_proto(const rg_item* item)
+{
+    ASSERT_M(item->proto < ITEM_PROTO_LEN);
+    return &item_prototypes[item->proto];
+}
+
 void heal(rg_item* item,
           rg_entity* target_entity,
           void* data,
           rg_turn_logs* logs,
           bool* is_consumed)
 {
-    int amount = item->heal.amount;
+    int amount = item_proto(item)->heal.amount;
 
     if (target_entity->fighter.hp == target_entity->fighter.max_hp)
     {
@@ -43,6 +143,20 @@ void heal(rg_item* item,
     }
 }
 
+typedef struct lightning_target_query
+{
+    const rg_entity* caster;
+    rg_fov_map* fov_map;
+} lightning_target_query;
+
+static bool lightning_target_filter(const rg_entity* e, void* user_data)
+{
+    lightning_target_query* query = user_data;
+    if (e == query->caster) return false;
+    if (e->dead) return false;
+    return fov_map_is_in_fov(query->fov_map, e->x, e->y);
+}
+
 void cast_lightning(rg_item* item,
                     rg_game_state_data* data,
                     rg_turn_logs* logs,
@@ -53,33 +167,29 @@ void cast_lightning(rg_item* item,
     rg_entity_array* entities = &data->entities;
     rg_entity* caster = &entities->data[data->player];
     rg_fov_map* fov_map = &data->fov_map;
-    int damage = item->lightning.damage;
-    int maximum_range = item->lightning.maximum_range;
+    int damage = item_proto(item)->lightning.damage;
+    int maximum_range = item_proto(item)->lightning.maximum_range;
 
     rg_entity* target = NULL;
-    int closest_distance = maximum_range + 1;
-    for (int i = 0; i < entities->len; i++)
-    {
-        rg_entity* e = &entities->data[i];
-        if (e == caster) continue;
-        if (e->ch == '%') continue; // dead entity
-        if (fov_map_is_in_fov(fov_map, e->x, e->y))
-        {
-            int distance = (int)entity_get_distance(caster, e);
-            if (distance < closest_distance)
-            {
-                target = e;
-                closest_distance = distance;
-            }
-        }
-    }
+    lightning_target_query query = { .caster = caster, .fov_map = fov_map };
+    rg_entity_id target_id;
+    if (spatial_query_nearest(&data->spatial,
+                              entities,
+                              caster->x,
+                              caster->y,
+                              maximum_range,
+                              lightning_target_filter,
+                              &query,
+                              &target_id))
+        target = &entities->data[target_id];
+
     if (target != NULL)
     {
         const char* fmt = "A lighting bolt strikes the %s with a loud "
                           "thunder! The damage is %d";
-        int len = snprintf(NULL, 0, fmt, target->name, damage);
+        int len = snprintf(NULL, 0, fmt, entity_name(target), damage);
         char* buf = malloc(sizeof(char) * (len + 1));
-        snprintf(buf, len, fmt, target->name, damage);
+        snprintf(buf, len, fmt, entity_name(target), damage);
         rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                     .text = buf,
                                     .color = WHITE };
@@ -116,8 +226,8 @@ void cast_fireball(rg_item* item,
 
     rg_entity_array* entities = &data->entities;
     rg_fov_map* fov_map = &data->fov_map;
-    int damage = item->fireball.damage;
-    int radius = item->fireball.radius;
+    int damage = item_proto(item)->fireball.damage;
+    int radius = item_proto(item)->fireball.radius;
     int target_x = data->target_x;
     int target_y = data->target_y;
 
@@ -148,29 +258,87 @@ void cast_fireball(rg_item* item,
         turn_logs_push(logs, &entry);
     }
 
-    for (int i = 0; i < entities->len; i++)
+    rg_entity_ids hits;
+    entity_ids_create(&hits, 8);
+    spatial_query_radius(
+      &data->spatial, entities, target_x, target_y, radius, &hits);
+    for (size_t i = 0; i < hits.len; i++)
     {
-        rg_entity* e = &entities->data[i];
+        rg_entity* e = &entities->data[hits.data[i]];
+
+        if (e->dead) continue;
+        const char* fmt = "The %s gets burned for %d hit points.";
+        int len = snprintf(NULL, 0, fmt, entity_name(e), damage);
+        char* buf = malloc(sizeof(char) * (len + 1));
+        snprintf(buf, len, fmt, entity_name(e), damage);
+        rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                    .text = buf,
+                                    .color = ORANGE };
+        turn_logs_push(logs, &entry);
+        bool is_dead;
+        int xp;
+        entity_take_damage(e, damage, logs, &is_dead, &xp);
+        if (is_dead)
+        {
+            entity_kill(e, logs);
+            // TODO: add xp
+        }
+    }
+    entity_ids_destroy(&hits);
 
-        if (e->ch == '%') continue; // Dead entity
-        if (entity_distance_to(e, target_x, target_y) <= radius)
+    const int fire = item_proto(item)->fireball.fire;
+    for (int y = target_y - radius; y <= target_y + radius; y++)
+    {
+        for (int x = target_x - radius; x <= target_x + radius; x++)
         {
-            const char* fmt = "The %s gets burned for %d hit points.";
-            int len = snprintf(NULL, 0, fmt, e->name, damage);
-            char* buf = malloc(sizeof(char) * (len + 1));
-            snprintf(buf, len, fmt, e->name, damage);
-            rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
-                                        .text = buf,
-                                        .color = ORANGE };
-            turn_logs_push(logs, &entry);
-            bool is_dead;
-            int xp;
-            entity_take_damage(e, damage, logs, &is_dead, &xp);
-            if (is_dead)
-            {
-                entity_kill(e, logs);
-                // TODO: add xp
-            }
+            const int dx = x - target_x;
+            const int dy = y - target_y;
+            if (dx * dx + dy * dy > radius * radius) continue;
+            if (map_is_blocked(&data->game_map, x, y)) continue;
+            hazards_add(&data->hazards, HAZARD_FIRE, x, y, fire);
+        }
+    }
+}
+
+void cast_cloud(rg_item* item,
+                rg_game_state_data* data,
+                rg_turn_logs* logs,
+                bool* is_consumed)
+{
+    *is_consumed = false;
+
+    const rg_item_proto* proto = item_proto(item);
+    const int radius = proto->cloud.radius;
+    const int target_x = data->target_x;
+    const int target_y = data->target_y;
+
+    if (!fov_map_is_in_fov(&data->fov_map, target_x, target_y))
+    {
+        char* buf =
+          strdup("You cannot target a tile outside your field of view.");
+        rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                    .text = buf,
+                                    .color = YELLOW };
+        turn_logs_push(logs, &entry);
+        return;
+    }
+
+    *is_consumed = true;
+    rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                .text = strdup(proto->cloud.msg),
+                                .color = proto->color };
+    turn_logs_push(logs, &entry);
+
+    for (int y = target_y - radius; y <= target_y + radius; y++)
+    {
+        for (int x = target_x - radius; x <= target_x + radius; x++)
+        {
+            const int dx = x - target_x;
+            const int dy = y - target_y;
+            if (dx * dx + dy * dy > radius * radius) continue;
+            if (map_is_blocked(&data->game_map, x, y)) continue;
+            hazards_add(
+              &data->hazards, proto->cloud.hazard, x, y, proto->cloud.amount);
         }
     }
 }
@@ -184,7 +352,7 @@ void cast_confuse(rg_item* item,
 
     rg_entity_array* entities = &data->entities;
     rg_fov_map* fov_map = &data->fov_map;
-    int amount = item->confuse.duration;
+    int amount = item_proto(item)->confuse.duration;
     int target_x = data->target_x;
     int target_y = data->target_y;
 
@@ -202,30 +370,33 @@ void cast_confuse(rg_item* item,
         return;
     }
 
-    for (int i = 0; i < entities->len; i++)
+    rg_entity_ids hits;
+    entity_ids_create(&hits, 4);
+    spatial_query_radius(
+      &data->spatial, entities, target_x, target_y, 0, &hits);
+    for (size_t i = 0; i < hits.len; i++)
     {
-        rg_entity* e = &entities->data[i];
+        rg_entity* e = &entities->data[hits.data[i]];
 
-        if (e->ch == '%') continue; // Dead entity
-        if (e->x == target_x && e->y == target_y)
-        {
-            e->state.data.confused.prev_state = e->state.type;
-            e->state.data.confused.num_turns = amount;
-            e->state.type = ENTITY_STATE_CONFUSED;
-
-            const char* fmt =
-              "The eyes of the %s look vacant, as he starts to stumble around!";
-            int len = snprintf(NULL, 0, fmt, e->name);
-            char* buf = malloc(sizeof(char) * (len + 1));
-            snprintf(buf, len, fmt, e->name);
-            rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
-                                        .text = buf,
-                                        .color = LIGHT_GREEN };
-            turn_logs_push(logs, &entry);
-            *is_consumed = true;
-            return;
-        }
+        if (e->dead) continue;
+        e->state.data.confused.prev_state = e->state.type;
+        e->state.data.confused.num_turns = amount;
+        e->state.type = ENTITY_STATE_CONFUSED;
+
+        const char* fmt =
+          "The eyes of the %s look vacant, as he starts to stumble around!";
+        int len = snprintf(NULL, 0, fmt, entity_name(e));
+        char* buf = malloc(sizeof(char) * (len + 1));
+        snprintf(buf, len, fmt, entity_name(e));
+        rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                    .text = buf,
+                                    .color = LIGHT_GREEN };
+        turn_logs_push(logs, &entry);
+        *is_consumed = true;
+        entity_ids_destroy(&hits);
+        return;
     }
+    entity_ids_destroy(&hits);
 
     const char* fmt = "There is no targetable enemy at that location.";
     int len = snprintf(NULL, 0, fmt);
@@ -244,7 +415,8 @@ void item_use(rg_item* item,
               bool* is_consumed)
 {
     *is_consumed = false;
-    switch (item->type)
+    const rg_item_proto* proto = item_proto(item);
+    switch (proto->type)
     {
     case ITEM_POTION_HEAL:
         heal(item, target_entity, data, logs, is_consumed);
@@ -269,11 +441,11 @@ void item_use(rg_item* item,
             state->target_x = -1;
             state->target_y = -1;
 
-            char* buf = strdup(item->fireball.targeting_msg);
+            char* buf = strdup(proto->fireball.targeting_msg);
             rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                         .text = buf,
                                         .color =
-                                          item->fireball.targeting_msg_color };
+                                          proto->fireball.targeting_msg_color };
             turn_logs_push(logs, &entry);
         }
         break;
@@ -295,11 +467,37 @@ void item_use(rg_item* item,
             state->target_x = -1;
             state->target_y = -1;
 
-            char* buf = strdup(item->confuse.targeting_msg);
+            char* buf = strdup(proto->confuse.targeting_msg);
+            rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
+                                        .text = buf,
+                                        .color =
+                                          proto->confuse.targeting_msg_color };
+            turn_logs_push(logs, &entry);
+        }
+        break;
+    }
+    case ITEM_HAZARD_CLOUD:
+    {
+        rg_game_state_data* state = data;
+        if (state->target_selected)
+        {
+            cast_cloud(item, state, logs, is_consumed);
+            state->target_selected = false;
+            state->targeting_item = NULL;
+        }
+        else
+        {
+            state->targeting_item = item;
+            state->prev_state = ST_TURN_PLAYER;
+            state->game_state = ST_TARGETING;
+            state->target_x = -1;
+            state->target_y = -1;
+
+            char* buf = strdup(proto->cloud.targeting_msg);
             rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                         .text = buf,
                                         .color =
-                                          item->confuse.targeting_msg_color };
+                                          proto->cloud.targeting_msg_color };
             turn_logs_push(logs, &entry);
         }
         break;
@@ -320,9 +518,9 @@ void item_use(rg_item* item,
             case ACTION_EQUIPPED:
             {
                 const char* fmt = "You equipped the %s";
-                int len = snprintf(NULL, 0, fmt, item->name);
+                int len = snprintf(NULL, 0, fmt, proto->name);
                 char* buf = malloc(sizeof(char) * (len + 1));
-                snprintf(buf, len + 1, fmt, item->name);
+                snprintf(buf, len + 1, fmt, proto->name);
                 rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                             .text = buf,
                                             .color = WHITE };
@@ -332,9 +530,9 @@ void item_use(rg_item* item,
             case ACTION_DEEQUIPPED:
             {
                 const char* fmt = "You dequipped the %s";
-                int len = snprintf(NULL, 0, fmt, item->name);
+                int len = snprintf(NULL, 0, fmt, proto->name);
                 char* buf = malloc(sizeof(char) * (len + 1));
-                snprintf(buf, len + 1, fmt, item->name);
+                snprintf(buf, len + 1, fmt, proto->name);
                 rg_turn_log_entry entry = { .type = TURN_LOG_MESSAGE,
                                             .text = buf,
                                             .color = WHITE };
@@ -6,17 +6,13 @@
 #include "entity.h"
 #include "turn_log.h"
 
-#define MAX_ITEM_NAME 50
-#define MAX_TRGT_MSG_LEN 75
-
 typedef enum rg_item_type
 {
     ITEM_POTION_HEAL,
     ITEM_LIGHTNING,
     ITEM_FIRE_BALL,
     ITEM_CAST_CONFUSE,
-    ITEM_SWORD,
-    ITEM_SHIELD,
+    ITEM_HAZARD_CLOUD,
     ITEM_EQUIPMENT,
     ITEM_LEN,
 } rg_item_type;
@@ -27,13 +23,27 @@ typedef enum rg_equipment_slot
     EQUIPMENT_SLOT_OFF_HAND,
 } rg_equipment_slot;
 
-typedef struct rg_item
+typedef enum rg_item_proto_id
 {
-    int x, y;
+    ITEM_PROTO_HEALING_POTION,
+    ITEM_PROTO_LIGHTNING_SCROLL,
+    ITEM_PROTO_FIREBALL_SCROLL,
+    ITEM_PROTO_CONFUSION_SCROLL,
+    ITEM_PROTO_SWORD,
+    ITEM_PROTO_SHIELD,
+    ITEM_PROTO_DAGGER,
+    ITEM_PROTO_FOG_SCROLL,
+    ITEM_PROTO_FLOOD_SCROLL,
+
+    ITEM_PROTO_LEN,
+} rg_item_proto_id;
+
+// Immutable data shared by every item of a kind.
+typedef struct rg_item_proto
+{
+    const char* name;
     char ch;
     SDL_Color color;
-    char name[MAX_ITEM_NAME];
-    bool visible_on_map;
     rg_item_type type;
     union
     {
@@ -50,16 +60,26 @@ typedef struct rg_item
         {
             int damage;
             int radius;
-            const char targeting_msg[MAX_TRGT_MSG_LEN];
+            int fire; // left burning on the floor
+            const char* targeting_msg;
             SDL_Color targeting_msg_color;
         } fireball;
         struct
         {
             int duration;
-            const char targeting_msg[MAX_TRGT_MSG_LEN];
+            const char* targeting_msg;
             SDL_Color targeting_msg_color;
         } confuse;
         struct
+        {
+            int hazard; // rg_hazard_kind
+            int amount; // added to every floor cell in the radius
+            int radius;
+            const char* msg;
+            const char* targeting_msg;
+            SDL_Color targeting_msg_color;
+        } cloud;
+        struct
         {
             rg_equipment_slot slot;
             int power_bonus;
@@ -67,6 +87,14 @@ typedef struct rg_item
             int max_hp_bonus;
         } equipable;
     };
+} rg_item_proto;
+
+extern const rg_item_proto item_prototypes[ITEM_PROTO_LEN];
+
+typedef struct rg_item
+{
+    int x, y;
+    rg_item_proto_id proto;
 } rg_item;
 
 typedef struct rg_items
@@ -76,6 +104,8 @@ typedef struct rg_items
     rg_item* data;
 } rg_items;
 
+const rg_item_proto* item_proto(const rg_item* item);
+
 void item_use(rg_item* item,
               rg_entity* target_entity,
               void* data,
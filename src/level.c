@@ -0,0 +1,135 @@
+#include "level.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "map_gen.h"
+#include "types.h"
+
+static bool level_cancelled(rg_level* l, SDL_atomic_t* cancel)
+{
+    if (cancel == NULL || !SDL_AtomicGet(cancel)) return false;
+    level_destroy(l);
+    return true;
+}
+
+// Returns false, with nothing left allocated, when `cancel` is set before
+// the level is done. `cancel` may be NULL.
+bool level_generate(rg_level* l,
+                    const rg_level_params* params,
+                    int level,
+                    rg_rng* rng,
+                    SDL_atomic_t* cancel)
+{
+    memset(l, 0, sizeof(*l));
+    l->entities.capacity = MAX(1, params->max_monsters_per_room);
+    l->entities.data = malloc(sizeof(*l->entities.data) * l->entities.capacity);
+    ASSERT_M(l->entities.data != NULL);
+    l->items.capacity = MAX(1, params->max_items_per_room);
+    l->items.data = malloc(sizeof(*l->items.data) * l->items.capacity);
+    ASSERT_M(l->items.data != NULL);
+
+    rg_entity player;
+    entity_create(&player, ENTITY_PROTO_PLAYER, 0, 0);
+    ARRAY_PUSH(&l->entities, player);
+    if (level_cancelled(l, cancel)) return false;
+
+    const rg_map_gen_params gen = { .width = params->map_width,
+                                    .height = params->map_height,
+                                    .level = level,
+                                    .room_min_size = params->room_min_size,
+                                    .room_max_size = params->room_max_size,
+                                    .max_rooms = params->max_rooms };
+    map_generate(&l->map,
+                 map_gen_for_level(level),
+                 &gen,
+                 rng,
+                 &l->entities,
+                 &l->items,
+                 0);
+    if (level_cancelled(l, cancel)) return false;
+
+    level_build(l);
+    return !level_cancelled(l, cancel);
+}
+
+// Creates the lookup structures of a level whose map, entities and items are
+// already set.
+void level_build(rg_level* l)
+{
+    const int w = l->map.width;
+    const int h = l->map.height;
+    spatial_grid_create(&l->spatial, w, h);
+    spatial_grid_build(&l->spatial, &l->entities);
+    item_stacks_create(&l->item_stacks, w, h);
+    item_stacks_build(&l->item_stacks, &l->items);
+
+    // FOV properties are synced around the viewer when it is computed.
+    fov_map_create(&l->fov_map, w, h);
+    hazards_create(&l->hazards, w, h);
+}
+
+void level_destroy(rg_level* l)
+{
+    if (l == NULL) return;
+    map_destroy(&l->map);
+    fov_map_destroy(&l->fov_map);
+    spatial_grid_destroy(&l->spatial);
+    item_stacks_destroy(&l->item_stacks);
+    hazards_destroy(&l->hazards);
+    free(l->entities.data);
+    free(l->items.data);
+    memset(l, 0, sizeof(*l));
+}
+
+static int pregen_run(void* user_data)
+{
+    rg_level_pregen* p = user_data;
+    level_generate(&p->staged, &p->params, p->level, &p->rng, &p->cancel);
+    return 0;
+}
+
+void level_pregen_start(rg_level_pregen* p,
+                        const rg_level_params* params,
+                        int level,
+                        const rg_rng* rng)
+{
+    ASSERT_M(p->thread == NULL);
+    p->params = *params;
+    p->level = level;
+    p->rng = *rng;
+    SDL_AtomicSet(&p->cancel, 0);
+    p->thread = SDL_CreateThread(pregen_run, "level_pregen", p);
+    if (p->thread == NULL)
+    {
+        // Not fatal, the level gets generated when the stairs are taken.
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "failed to start level pregeneration %s",
+                    SDL_GetError());
+    }
+}
+
+bool level_pregen_take(rg_level_pregen* p, int level, rg_level* out)
+{
+    if (p->thread == NULL) return false;
+    SDL_WaitThread(p->thread, NULL);
+    p->thread = NULL;
+    if (p->level != level)
+    {
+        level_destroy(&p->staged);
+        return false;
+    }
+    *out = p->staged;
+    memset(&p->staged, 0, sizeof(p->staged));
+    return true;
+}
+
+void level_pregen_cancel(rg_level_pregen* p)
+{
+    if (p->thread == NULL) return;
+    SDL_AtomicSet(&p->cancel, 1);
+    SDL_WaitThread(p->thread, NULL);
+    p->thread = NULL;
+    level_destroy(&p->staged);
+}
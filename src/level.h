@@ -0,0 +1,69 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "entity.h"
+#include "fov.h"
+#include "game_map.h"
+#include "hazards.h"
+#include "item_stacks.h"
+#include "items.h"
+#include "rng.h"
+#include "spatial.h"
+
+typedef struct rg_level_params
+{
+    int map_width;
+    int map_height;
+    int room_min_size;
+    int room_max_size;
+    int max_rooms; // per chunk
+    int max_monsters_per_room;
+    int max_items_per_room;
+} rg_level_params;
+
+// Everything that belongs to one dungeon level. Entity 0 is a stand-in for
+// the player that only carries the start position.
+typedef struct rg_level
+{
+    rg_map map;
+    rg_fov_map fov_map;
+    rg_entity_array entities;
+    rg_spatial_grid spatial;
+    rg_items items;
+    rg_item_stacks item_stacks;
+    rg_hazards hazards;
+} rg_level;
+
+// Generates the next level on a worker thread while the current one is
+// played. The staged level is only touched by the worker until it is joined.
+// Cancelling sets `cancel`, which the worker checks between passes.
+typedef struct rg_level_pregen
+{
+    SDL_Thread* thread;
+    SDL_atomic_t cancel;
+    rg_level_params params;
+    int level;
+    rg_rng rng;
+    rg_level staged;
+} rg_level_pregen;
+
+bool level_generate(rg_level* l,
+                    const rg_level_params* params,
+                    int level,
+                    rg_rng* rng,
+                    SDL_atomic_t* cancel);
+void level_build(rg_level* l);
+void level_destroy(rg_level* l);
+
+void level_pregen_start(rg_level_pregen* p,
+                        const rg_level_params* params,
+                        int level,
+                        const rg_rng* rng);
+bool level_pregen_take(rg_level_pregen* p, int level, rg_level* out);
+void level_pregen_cancel(rg_level_pregen* p);
+
+#endif
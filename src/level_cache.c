@@ -0,0 +1,193 @@
+#include "level_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "types.h"
+
+static void entity_record_pack(rg_entity_record* r, const rg_entity* e)
+{
+    memset(r, 0, sizeof(*r));
+    r->x = (int16_t)e->x;
+    r->y = (int16_t)e->y;
+    r->proto = (uint8_t)e->proto;
+    r->dead = e->dead;
+    r->state = (uint8_t)e->state.type;
+    if (e->state.type == ENTITY_STATE_CONFUSED)
+    {
+        r->confused_turns = (int16_t)e->state.data.confused.num_turns;
+        r->confused_prev_state = (uint8_t)e->state.data.confused.prev_state;
+    }
+    r->hp = (int16_t)e->fighter.hp;
+}
+
+static void entity_record_unpack(const rg_entity_record* r, rg_entity* e)
+{
+    entity_create(e, r->proto, r->x, r->y);
+    e->dead = r->dead;
+    e->state.type = r->state;
+    if (e->state.type == ENTITY_STATE_CONFUSED)
+    {
+        e->state.data.confused.num_turns = r->confused_turns;
+        e->state.data.confused.prev_state = r->confused_prev_state;
+    }
+    e->fighter.hp = r->hp;
+}
+
+void level_snapshot_create(rg_level_snapshot* s,
+                           rg_map* m,
+                           const rg_entity_array* entities,
+                           rg_entity_id player,
+                           const rg_items* items)
+{
+    memset(s, 0, sizeof(*s));
+    s->depth = m->level;
+    s->width = m->width;
+    s->height = m->height;
+    s->player.x = entities->data[player].x;
+    s->player.y = entities->data[player].y;
+
+    s->layout = m->layout;
+
+    const int chunks = m->chunks_wide * m->chunks_high;
+    s->chunks = malloc(sizeof(*s->chunks) * chunks);
+    ASSERT_M(s->chunks != NULL);
+    s->data.capacity = 256;
+    s->data.data = malloc(s->data.capacity);
+    ASSERT_M(s->data.data != NULL);
+    rg_map_chunk scratch;
+    for (int i = 0; i < chunks; i++)
+    {
+        const int cx = i % m->chunks_wide;
+        const int cy = i / m->chunks_wide;
+        if (!map_chunk_is_built(m, cx, cy)) continue;
+        s->chunks[s->chunks_len++] = i;
+        const rg_map_chunk* c = map_chunk_peek(m, cx, cy, &scratch);
+        rle_encode(&s->data, (const uint8_t*)c, sizeof(*c));
+    }
+
+    s->entities = malloc(sizeof(*s->entities) * MAX(entities->len, 1));
+    ASSERT_M(s->entities != NULL);
+    for (size_t i = 0; i < entities->len; i++)
+    {
+        if (i == player) continue;
+        entity_record_pack(&s->entities[s->entities_len++], &entities->data[i]);
+    }
+
+    s->items.len = items->len;
+    s->items.capacity = MAX(items->len, 1);
+    s->items.data = malloc(sizeof(*s->items.data) * s->items.capacity);
+    ASSERT_M(s->items.data != NULL);
+    memcpy(s->items.data, items->data, sizeof(*items->data) * items->len);
+}
+
+void level_snapshot_destroy(rg_level_snapshot* s)
+{
+    free(s->chunks);
+    free(s->data.data);
+    free(s->entities);
+    free(s->items.data);
+    memset(s, 0, sizeof(*s));
+}
+
+void level_cache_create(rg_level_cache* c)
+{
+    c->len = 0;
+    c->capacity = 4;
+    c->data = malloc(sizeof(*c->data) * c->capacity);
+    ASSERT_M(c->data != NULL);
+}
+
+void level_cache_destroy(rg_level_cache* c)
+{
+    for (size_t i = 0; i < c->len; i++) level_snapshot_destroy(&c->data[i]);
+    free(c->data);
+    memset(c, 0, sizeof(*c));
+}
+
+static int level_cache_find(const rg_level_cache* c, int depth)
+{
+    for (size_t i = 0; i < c->len; i++)
+    {
+        if (c->data[i].depth == depth) return (int)i;
+    }
+    return -1;
+}
+
+// Takes ownership of the snapshot, replacing an older one of the same depth.
+void level_cache_put(rg_level_cache* c, rg_level_snapshot* s)
+{
+    const int i = level_cache_find(c, s->depth);
+    if (i != -1)
+    {
+        level_snapshot_destroy(&c->data[i]);
+        c->data[i] = *s;
+    }
+    else
+    {
+        ARRAY_PUSH(c, *s);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+void level_cache_store(rg_level_cache* c,
+                       rg_map* m,
+                       const rg_entity_array* entities,
+                       rg_entity_id player,
+                       const rg_items* items)
+{
+    rg_level_snapshot s;
+    level_snapshot_create(&s, m, entities, player, items);
+    level_cache_put(c, &s);
+}
+
+bool level_cache_contains(const rg_level_cache* c, int depth)
+{
+    return level_cache_find(c, depth) != -1;
+}
+
+// Rebuilds the level and drops its snapshot. Entity 0 of the level stands in
+// for the player at the position it left from.
+bool level_cache_take(rg_level_cache* c, int depth, rg_level* out)
+{
+    const int i = level_cache_find(c, depth);
+    if (i == -1) return false;
+    rg_level_snapshot* s = &c->data[i];
+
+    memset(out, 0, sizeof(*out));
+    rg_map* m = &out->map;
+    map_alloc(m, s->width, s->height, s->depth);
+    m->layout = s->layout;
+    size_t pos = 0;
+    for (size_t k = 0; k < s->chunks_len; k++)
+    {
+        const int cx = s->chunks[k] % m->chunks_wide;
+        const int cy = s->chunks[k] / m->chunks_wide;
+        rg_map_chunk* chunk = map_chunk_build(m, cx, cy);
+        pos = rle_decode(&s->data, pos, (uint8_t*)chunk, sizeof(*chunk));
+    }
+
+    out->entities.len = 0;
+    out->entities.capacity = s->entities_len + 1;
+    out->entities.data =
+      malloc(sizeof(*out->entities.data) * out->entities.capacity);
+    ASSERT_M(out->entities.data != NULL);
+    rg_entity e;
+    entity_create(&e, ENTITY_PROTO_PLAYER, s->player.x, s->player.y);
+    ARRAY_PUSH(&out->entities, e);
+    for (size_t k = 0; k < s->entities_len; k++)
+    {
+        entity_record_unpack(&s->entities[k], &e);
+        ARRAY_PUSH(&out->entities, e);
+    }
+
+    out->items = s->items;
+    s->items.data = NULL;
+    level_build(out);
+
+    level_snapshot_destroy(s);
+    c->data[i] = c->data[c->len - 1];
+    c->len--;
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <SDL.h>
+
+#include "entity.h"
+#include "game_map.h"
+#include "items.h"
+#include "level.h"
+#include "rle.h"
+
+// What a monster, corpse or stairs needs on top of its prototype.
+typedef struct rg_entity_record
+{
+    int16_t x;
+    int16_t y;
+    uint8_t proto;
+    uint8_t dead;
+    uint8_t state;
+    uint8_t confused_prev_state;
+    int16_t confused_turns;
+    int16_t hp;
+} rg_entity_record;
+
+// A level the player has left. Only chunks that were generated are kept,
+// each run length encoded, the rest is generated from the layout later.
+typedef struct rg_level_snapshot
+{
+    int depth;
+    int width;
+    int height;
+    SDL_Point player; // where the player left, on the stairs
+    rg_map_layout layout;
+    size_t chunks_len;
+    int* chunks;  // chunk indices, in the order they appear in `data`
+    rg_bytes data;
+    size_t entities_len;
+    rg_entity_record* entities;
+    rg_items items;
+} rg_level_snapshot;
+
+typedef struct rg_level_cache
+{
+    size_t len;
+    size_t capacity;
+    rg_level_snapshot* data;
+} rg_level_cache;
+
+void level_snapshot_create(rg_level_snapshot* s,
+                           rg_map* m,
+                           const rg_entity_array* entities,
+                           rg_entity_id player,
+                           const rg_items* items);
+void level_snapshot_destroy(rg_level_snapshot* s);
+
+void level_cache_create(rg_level_cache* c);
+void level_cache_destroy(rg_level_cache* c);
+void level_cache_put(rg_level_cache* c, rg_level_snapshot* s);
+void level_cache_store(rg_level_cache* c,
+                       rg_map* m,
+                       const rg_entity_array* entities,
+                       rg_entity_id player,
+                       const rg_items* items);
+bool level_cache_contains(const rg_level_cache* c, int depth);
+bool level_cache_take(rg_level_cache* c, int depth, rg_level* out);
+
+#endif
@@ -2,7 +2,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -24,13 +24,14 @@
 #include "mainmenu_state.h"
 #include "panic.h"
 #include "savefile.h"
+#include "sim.h"
 #include "terminal.h"
 #include "tileset.h"
 #include "turn_log.h"
 #include "types.h"
 
-#define DESIRED_FPS 20.0
-#define DESIRED_FRAME_RATE ((1.0 / DESIRED_FPS) * 1000.0)
+// Frame pacing when the display doesn't report its refresh rate.
+#define DEFAULT_REFRESH_RATE 60
 
 static void update(rg_app* app, SDL_Event* event)
 {
@@ -50,6 +51,7 @@ static void update(rg_app* app, SDL_Event* event)
 
 static void draw(rg_app* app)
 {
+    tileset_next_frame(&app->tileset);
     switch (app->screen)
     {
     case APP_SCREEN_MENU:
@@ -64,13 +66,222 @@ static void draw(rg_app* app)
     }
 }
 
+// Updates the menu with one event and returns true if the frame has to be
+// redrawn. The game is updated on its own thread.
+static bool handle_event(rg_app* app, SDL_Event* event)
+{
+    const app_screen screen = app->screen;
+    update(app, event);
+    return app->screen != screen || event_forces_redraw(event);
+}
+
+// Events of one pass of the main loop. Mouse motion is coalesced, only the
+// last position of a run of motion events is handled. While a game is on
+// screen input is forwarded to it and its frames are drawn from here.
+typedef struct rg_input
+{
+    SDL_Event motion;
+    bool has_motion;
+    rg_sim sim;
+    rg_frame* shown; // last frame taken from the game
+    SDL_Event pending[EVENT_QUEUE_LEN]; // input the game did not get to
+} rg_input;
+
+// The game went back to the menu and its thread is done with the state.
+// Input posted after the game stopped reading it goes to the menu.
+static bool input_end_game(rg_app* app, rg_input* in)
+{
+    const int len = sim_finish(&in->sim, in->pending);
+    in->shown = NULL;
+    bool dirty = true;
+    for (int i = 0; i < len; i++) dirty |= handle_event(app, &in->pending[i]);
+    return dirty;
+}
+
+static bool input_dispatch(rg_app* app, rg_input* in, SDL_Event* event)
+{
+    bool dirty = false;
+    if (sim_has_ended(&in->sim)) dirty = input_end_game(app, in);
+    if (!sim_is_running(&in->sim)) return handle_event(app, event) || dirty;
+    if (!sim_post(&in->sim, event))
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "input dropped, game behind");
+    return false;
+}
+
+static bool input_flush(rg_app* app, rg_input* in)
+{
+    if (!in->has_motion) return false;
+    in->has_motion = false;
+    return input_dispatch(app, in, &in->motion);
+}
+
+// Starts the game thread once the menu switched to the play screen.
+static void input_follow_screen(rg_app* app, rg_input* in)
+{
+    if (sim_is_running(&in->sim) || app->screen != APP_SCREEN_PLAY) return;
+    sim_start(&in->sim, app);
+    in->shown = NULL;
+}
+
+static bool input_frame(rg_app* app, rg_input* in)
+{
+    rg_frame* f = sim_take_frame(&in->sim);
+    if (f == NULL) return false;
+    if (f->ended) return input_end_game(app, in);
+    in->shown = f;
+    return true;
+}
+
+static bool input_event(rg_app* app, rg_input* in, SDL_Event* event)
+{
+    if (event->type == SDL_MOUSEMOTION)
+    {
+        in->motion = *event;
+        in->has_motion = true;
+        return false;
+    }
+    bool dirty = input_flush(app, in);
+    if (event->type == SDL_QUIT)
+    {
+        app->running = false;
+        return dirty;
+    }
+    if (event->type == SDL_RENDER_TARGETS_RESET ||
+        event->type == SDL_RENDER_DEVICE_RESET)
+        console_targets_reset();
+    // A game that ended on a flushed motion may still have its frame event
+    // queued, it is not input for the menu.
+    if (event->type == in->sim.frame_event && in->sim.frame_event != 0)
+        return (sim_is_running(&in->sim) && input_frame(app, in)) || dirty;
+    if (sim_is_running(&in->sim))
+    {
+        // Painting is done here, the game only needs input.
+        if (event->type == SDL_WINDOWEVENT ||
+            event->type == SDL_RENDER_TARGETS_RESET ||
+            event->type == SDL_RENDER_DEVICE_RESET)
+            return true;
+    }
+    dirty |= input_dispatch(app, in, event);
+    input_follow_screen(app, in);
+    return dirty;
+}
+
+static void input_draw(rg_app* app, rg_input* in)
+{
+    if (!sim_is_running(&in->sim))
+    {
+        draw(app);
+        return;
+    }
+    if (in->shown == NULL) return;
+    tileset_next_frame(&app->tileset);
+    frame_view_render(&app->game_view, in->shown);
+}
+
+typedef struct rg_options
+{
+    bool headless;
+    bool new_game;        // skip the main menu
+    int frames;           // frames drawn when headless
+    const char* snapshot; // BMP of the last headless frame
+    uint64_t seed;
+    int map_width; // of new games
+    int map_height;
+} rg_options;
+
+static void usage(const char* exe)
+{
+    fprintf(stderr,
+            "usage: %s [--headless] [--frames N] [--snapshot FILE.bmp] "
+            "[--new-game] [--seed N] [--map-size WxH]\n",
+            exe);
+    exit(1);
+}
+
+static void parse_options(rg_options* opts, int argc, char* argv[])
+{
+    memset(opts, 0, sizeof(*opts));
+    opts->frames = 100;
+    opts->map_width = 320;
+    opts->map_height = 192;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--headless") == 0)
+            opts->headless = true;
+        else if (strcmp(arg, "--new-game") == 0)
+            opts->new_game = true;
+        else if (strcmp(arg, "--frames") == 0 && has_value)
+            opts->frames = atoi(argv[++i]);
+        else if (strcmp(arg, "--snapshot") == 0 && has_value)
+            opts->snapshot = argv[++i];
+        else if (strcmp(arg, "--seed") == 0 && has_value)
+            opts->seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--map-size") == 0 && has_value)
+        {
+            if (sscanf(argv[++i],
+                       "%dx%d",
+                       &opts->map_width,
+                       &opts->map_height) != 2)
+                usage(argv[0]);
+        }
+        else
+            usage(argv[0]);
+    }
+    if (opts->frames < 1 || opts->map_width < 1 || opts->map_height < 1)
+        usage(argv[0]);
+    // Chunks are generated whole, one holds several rooms.
+    opts->map_width = (opts->map_width + MAP_CHUNK_MASK) & ~MAP_CHUNK_MASK;
+    opts->map_height = (opts->map_height + MAP_CHUNK_MASK) & ~MAP_CHUNK_MASK;
+}
+
+// Draws a fixed number of frames without input and reports how long the draw
+// took, for benchmarks and frame comparisons on machines without a display.
+static int run_headless(rg_app* app, const rg_options* opts)
+{
+    SDL_Event event = { 0 };
+    update(app, &event);
+
+    const double freq = (double)SDL_GetPerformanceFrequency();
+    double total = 0.0;
+    double worst = 0.0;
+    for (int i = 0; i < opts->frames && app->running; i++)
+    {
+        // The state does not change between frames, without this every
+        // frame after the first would only composite unchanged consoles.
+        console_targets_reset();
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        draw(app);
+        Uint64 frame_end = SDL_GetPerformanceCounter();
+        const double ms = (frame_end - frame_start) / freq * 1000.0;
+        total += ms;
+        if (ms > worst) worst = ms;
+    }
+    printf("%d frames, %.3f ms average, %.3f ms worst\n",
+           opts->frames,
+           total / opts->frames,
+           worst);
+
+    if (opts->snapshot != NULL && !app_snapshot(app, opts->snapshot))
+    {
+        fprintf(stderr,
+                "failed to write %s: %s\n",
+                opts->snapshot,
+                SDL_GetError());
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
 #ifdef _WIN32
      SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE);
 #endif
 
-    srand((unsigned int)time(NULL));
+    rg_options opts;
+    parse_options(&opts, argc, argv);
 
     rg_app app;
     app_create(&app,
@@ -80,52 +291,75 @@ int main(int argc, char* argv[])
                10,
                32,
                8,
-               "res/menu_background.png");
+               "res/menu_background.png",
+               opts.headless);
+    app.seed = opts.seed;
+    app.map_width = opts.map_width;
+    app.map_height = opts.map_height;
 
     mainmenu_state_create(&app.menu_state_data, &app);
+    if (opts.new_game)
+    {
+        game_state_create_game(&app.game_state_data, &app);
+        app.screen = APP_SCREEN_PLAY;
+    }
+    if (opts.headless)
+    {
+        const int status = run_headless(&app, &opts);
+        if (app.screen == APP_SCREEN_PLAY)
+            game_state_destroy(&app.game_state_data);
+        mainmenu_state_destroy(&app.menu_state_data);
+        app_destroy(&app);
+        return status;
+    }
+
     SDL_Event event = { 0 };
 
+    rg_input in = { 0 };
     update(&app, &event);
     draw(&app);
+    input_follow_screen(&app, &in);
 
-
+    // Draw at most once per refresh, and only when something on screen may
+    // have changed. With nothing to do the loop sleeps in SDL_WaitEvent,
+    // the game thread wakes it with a frame event.
+    SDL_DisplayMode mode;
+    int refresh_rate = DEFAULT_REFRESH_RATE;
+    const int display = SDL_GetWindowDisplayIndex(app.window);
+    if (SDL_GetCurrentDisplayMode(display, &mode) == 0 &&
+        mode.refresh_rate > 0)
+        refresh_rate = mode.refresh_rate;
+    const Uint32 frame_period = 1000 / refresh_rate;
+    Uint32 last_draw = SDL_GetTicks();
+    bool dirty = false;
     while (app.running)
     {
-        SDL_WaitEvent(&event);
-        if (event.type == SDL_QUIT)
+        if (dirty)
         {
-            app.running = false;
-            break;
+            const Uint32 since = SDL_GetTicks() - last_draw;
+            if (since < frame_period &&
+                SDL_WaitEventTimeout(&event, frame_period - since))
+                dirty |= input_event(&app, &in, &event);
         }
+        else if (SDL_WaitEvent(&event))
+        {
+            dirty |= input_event(&app, &in, &event);
+        }
+        while (app.running && SDL_PollEvent(&event))
+            dirty |= input_event(&app, &in, &event);
+        dirty |= input_flush(&app, &in);
+        input_follow_screen(&app, &in);
+        if (!app.running) break;
 
-        Uint64 frame_start = SDL_GetPerformanceCounter();
-
-        update(&app, &event);
-        draw(&app);
-        
-        #if 0
-        SDL_SetRenderTarget(app.renderer, NULL);
-        SDL_SetRenderDrawColor(app.renderer, 0, 0, 0, 255);
-        SDL_RenderClear(app.renderer);
-        SDL_Rect dest = { 0 };
-        SDL_QueryTexture(app.tileset.texture, NULL, NULL, &dest.w, &dest.h);
-        SDL_RenderCopy(app.renderer, app.tileset.texture, NULL, &dest);
-        SDL_SetRenderDrawColor(app.renderer, 0, 255, 0, 255);
-        SDL_RenderDrawRect(app.renderer, &dest);
-        SDL_RenderPresent(app.renderer);
-        #endif
-
-        Uint64 frame_end = SDL_GetPerformanceCounter();
-        double dt = (frame_end - frame_start) /
-                    (double)SDL_GetPerformanceFrequency() * 1000.0;
-
-        Uint32 sleep_time = (Uint32)floor(DESIRED_FRAME_RATE - dt);
-        const Uint32 max_sleep_time = 1000;
-        if (sleep_time > max_sleep_time) sleep_time = max_sleep_time;
-        // SLEEP
-        SDL_Delay(sleep_time);
+        if (dirty && SDL_GetTicks() - last_draw >= frame_period)
+        {
+            input_draw(&app, &in);
+            last_draw = SDL_GetTicks();
+            dirty = false;
+        }
     }
+    sim_stop(&in.sim);
     mainmenu_state_destroy(&app.menu_state_data);
     app_destroy(&app);
     return 0;
-}
\ No newline at end of file
+}
@@ -109,7 +109,7 @@ void mainmenu_state_draw(struct rg_app* app, rg_main_menu_state_data* data)
                   NULL,
                   50,
                   &message_box_height);
-        console_end(&data->menu_options);
+        console_end(&data->message_box);
     }
 
     SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
@@ -0,0 +1,999 @@
+#include "map_gen.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "spawn.h"
+#include "types.h"
+
+#define CAVE_FILL_PERCENT 45
+#define CAVE_ITERATIONS 5
+#define DRUNKARD_FLOOR_PERCENT 40
+// Chunks this close to the player, in chunks, get generated. Stays within
+// MAP_CHUNK_KEEP so fresh chunks aren't evicted right away.
+#define GEN_NEAR 1
+
+// Working copy of a chunk while it is generated, one bit per cell, set for
+// walls. Bits past the width stay set so they read as walls too.
+typedef struct gen_grid
+{
+    int width;
+    int height;
+    int stride; // words per row
+    uint64_t* bits;
+} gen_grid;
+
+// Every chunk is generated on its own, in chunk cells, from a seed derived
+// from the layout and its position. Neighbors are joined through one portal
+// per shared edge, which both sides derive the same way, so the level is
+// connected whatever order its chunks come out in.
+typedef struct gen_ctx
+{
+    rg_map* map;
+    const rg_map_layout* layout;
+    gen_grid grid;
+    SDL_Point origin;   // of the chunk, in map cells
+    rg_map_rects areas; // spawn areas, in chunk cells
+    rg_rng* rng;
+} gen_ctx;
+
+typedef struct rg_map_generator
+{
+    const char* name;
+    // Lays out the chunk and sets `anchor` to a floor cell that everything
+    // carved is connected to. False when nothing could be carved.
+    bool (*build)(gen_ctx* ctx, SDL_Point* anchor);
+    // Runs once the chunk is in the map.
+    void (*finish)(gen_ctx* ctx);
+} rg_map_generator;
+
+// Accepted rooms bucketed by the coarse cells they overlap. A candidate is
+// only tested against the rooms sharing a cell with it, which gives the same
+// answers as testing every room.
+typedef struct room_node
+{
+    int room;
+    int next; // next node of the same cell, -1 at the end
+} room_node;
+
+typedef struct room_nodes
+{
+    size_t len;
+    size_t capacity;
+    room_node* data;
+} room_nodes;
+
+typedef struct room_index
+{
+    int shift; // cells are 1 << shift wide, at least the largest room
+    int width;
+    int height;
+    int* heads; // first node per cell, -1 when empty
+    room_nodes nodes;
+} room_index;
+
+static void room_index_create(room_index* idx, int w, int h, int max_size)
+{
+    idx->shift = 0;
+    while ((1 << idx->shift) < max_size) idx->shift++;
+    idx->width = (w >> idx->shift) + 1;
+    idx->height = (h >> idx->shift) + 1;
+    const int len = idx->width * idx->height;
+    idx->heads = malloc(sizeof(*idx->heads) * len);
+    ASSERT_M(idx->heads != NULL);
+    for (int i = 0; i < len; i++) idx->heads[i] = -1;
+    idx->nodes.len = 0;
+    idx->nodes.capacity = 16;
+    idx->nodes.data = malloc(sizeof(*idx->nodes.data) * idx->nodes.capacity);
+    ASSERT_M(idx->nodes.data != NULL);
+}
+
+static void room_index_destroy(room_index* idx)
+{
+    free(idx->heads);
+    free(idx->nodes.data);
+}
+
+// Cells covered by r, inclusive.
+static void room_index_span(const room_index* idx,
+                            const SDL_Rect* r,
+                            SDL_Rect* cells)
+{
+    cells->x = r->x >> idx->shift;
+    cells->y = r->y >> idx->shift;
+    cells->w = ((r->x + r->w - 1) >> idx->shift) - cells->x + 1;
+    cells->h = ((r->y + r->h - 1) >> idx->shift) - cells->y + 1;
+}
+
+static void room_index_add(room_index* idx, const rg_map_rects* rooms, int room)
+{
+    SDL_Rect cells;
+    room_index_span(idx, &rooms->data[room], &cells);
+    for (int cy = cells.y; cy < cells.y + cells.h; cy++)
+    {
+        for (int cx = cells.x; cx < cells.x + cells.w; cx++)
+        {
+            int* head = &idx->heads[cx + cy * idx->width];
+            room_node node = { .room = room, .next = *head };
+            *head = (int)idx->nodes.len;
+            ARRAY_PUSH(&idx->nodes, node);
+        }
+    }
+}
+
+static bool room_index_intersects(const room_index* idx,
+                                   const rg_map_rects* rooms,
+                                   const SDL_Rect* r)
+{
+    SDL_Rect cells;
+    room_index_span(idx, r, &cells);
+    for (int cy = cells.y; cy < cells.y + cells.h; cy++)
+    {
+        for (int cx = cells.x; cx < cells.x + cells.w; cx++)
+        {
+            int n = idx->heads[cx + cy * idx->width];
+            for (; n != -1; n = idx->nodes.data[n].next)
+            {
+                const SDL_Rect* other = &rooms->data[idx->nodes.data[n].room];
+                if (SDL_HasIntersection(r, other)) return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool build_rooms(gen_ctx* ctx, SDL_Point* anchor);
+static bool build_bsp(gen_ctx* ctx, SDL_Point* anchor);
+static bool build_drunkard(gen_ctx* ctx, SDL_Point* anchor);
+static bool build_caves(gen_ctx* ctx, SDL_Point* anchor);
+static void gen_doors(gen_ctx* ctx);
+static void gen_open_areas(gen_ctx* ctx);
+
+static const rg_map_generator generators[MAP_GEN_LEN] = {
+    [MAP_GEN_ROOMS] = { "rooms", build_rooms, gen_doors },
+    [MAP_GEN_BSP] = { "bsp", build_bsp, gen_doors },
+    [MAP_GEN_DRUNKARD] = { "drunkard", build_drunkard, gen_open_areas },
+    [MAP_GEN_CAVES] = { "caves", build_caves, gen_open_areas },
+};
+
+// Cycled through by dungeon level.
+static const rg_map_gen_kind level_generators[] = {
+    MAP_GEN_ROOMS, MAP_GEN_BSP,      MAP_GEN_CAVES,
+    MAP_GEN_ROOMS, MAP_GEN_DRUNKARD, MAP_GEN_CAVES,
+};
+
+#define TABLE_LEN(t) ((int)(sizeof(t) / sizeof((t)[0])))
+
+rg_map_gen_kind map_gen_for_level(int level)
+{
+    ASSERT_M(level >= 1);
+    return level_generators[(level - 1) % TABLE_LEN(level_generators)];
+}
+
+const char* map_gen_name(rg_map_gen_kind kind)
+{
+    ASSERT_M(kind < MAP_GEN_LEN);
+    return generators[kind].name;
+}
+
+static void grid_create(gen_grid* g, int width, int height)
+{
+    g->width = width;
+    g->height = height;
+    g->stride = (width + 63) / 64;
+    const size_t size = sizeof(*g->bits) * g->stride * height;
+    g->bits = malloc(size);
+    ASSERT_M(g->bits != NULL);
+    memset(g->bits, 0xff, size);
+}
+
+static void grid_destroy(gen_grid* g)
+{
+    free(g->bits);
+}
+
+static uint64_t* grid_row(const gen_grid* g, int y)
+{
+    return &g->bits[y * g->stride];
+}
+
+static bool grid_is_wall(const gen_grid* g, int x, int y)
+{
+    return (grid_row(g, y)[x >> 6] >> (x & 63)) & 1;
+}
+
+static void grid_set(gen_grid* g, int x, int y, bool wall)
+{
+    uint64_t* word = &grid_row(g, y)[x >> 6];
+    const uint64_t bit = 1ull << (x & 63);
+    *word = wall ? (*word | bit) : (*word & ~bit);
+}
+
+static void gen_carve(gen_ctx* ctx, int x, int y, int w, int h)
+{
+    for (int cy = y; cy < y + h; cy++)
+        for (int cx = x; cx < x + w; cx++) grid_set(&ctx->grid, cx, cy, false);
+}
+
+// Walls sit on room.x and room.y, the interior becomes a spawn area.
+static void gen_room(gen_ctx* ctx, const SDL_Rect* room)
+{
+    const SDL_Rect area = {
+        .x = room->x + 1, .y = room->y + 1, .w = room->w - 1, .h = room->h - 1
+    };
+    gen_carve(ctx, area.x, area.y, area.w, area.h);
+    ARRAY_PUSH(&ctx->areas, area);
+}
+
+static SDL_Point room_center(const SDL_Rect* r)
+{
+    return (SDL_Point){ .x = (r->x + r->x + r->w) / 2,
+                        .y = (r->y + r->y + r->h) / 2 };
+}
+
+static void gen_h_tunnel(gen_ctx* ctx, int x1, int x2, int y)
+{
+    gen_carve(ctx, MIN(x1, x2), y, abs(x2 - x1) + 1, 1);
+}
+
+static void gen_v_tunnel(gen_ctx* ctx, int y1, int y2, int x)
+{
+    gen_carve(ctx, x, MIN(y1, y2), 1, abs(y2 - y1) + 1);
+}
+
+// L shaped tunnel, bending either way.
+static void gen_connect(gen_ctx* ctx, SDL_Point a, SDL_Point b)
+{
+    if (rng_int(ctx->rng, 0, 1) == 1)
+    {
+        gen_h_tunnel(ctx, a.x, b.x, a.y);
+        gen_v_tunnel(ctx, a.y, b.y, b.x);
+    }
+    else
+    {
+        gen_v_tunnel(ctx, a.y, b.y, a.x);
+        gen_h_tunnel(ctx, a.x, b.x, b.y);
+    }
+}
+
+// A floor cell squeezed between two walls, where a tunnel meets a room.
+static bool gen_is_doorway(const gen_grid* g, int x, int y)
+{
+    if (x <= 0 || y <= 0 || x >= g->width - 1 || y >= g->height - 1)
+        return false;
+    if (grid_is_wall(g, x, y)) return false;
+    return (grid_is_wall(g, x - 1, y) && grid_is_wall(g, x + 1, y)) ||
+           (grid_is_wall(g, x, y - 1) && grid_is_wall(g, x, y + 1));
+}
+
+static void gen_door(gen_ctx* ctx, int x, int y)
+{
+    if (!gen_is_doorway(&ctx->grid, x, y) || rng_int(ctx->rng, 0, 1) == 0)
+        return;
+    map_set_tile(
+      ctx->map, ctx->origin.x + x, ctx->origin.y + y, TILE_DOOR_CLOSED);
+    // Nothing spawns in the doorway.
+    grid_set(&ctx->grid, x, y, true);
+}
+
+// Puts doors in the walls around the rooms, once the tunnels to the portals
+// are carved so they get doors too.
+static void gen_doors(gen_ctx* ctx)
+{
+    for (size_t i = 0; i < ctx->areas.len; i++)
+    {
+        const SDL_Rect* a = &ctx->areas.data[i];
+        for (int x = a->x; x < a->x + a->w; x++)
+        {
+            gen_door(ctx, x, a->y - 1);
+            gen_door(ctx, x, a->y + a->h);
+        }
+        for (int y = a->y; y < a->y + a->h; y++)
+        {
+            gen_door(ctx, a->x - 1, y);
+            gen_door(ctx, a->x + a->w, y);
+        }
+    }
+}
+
+// Splits the chunk into square spawn areas, keeping those with enough floor
+// in them.
+static void gen_open_areas(gen_ctx* ctx)
+{
+    const gen_grid* g = &ctx->grid;
+    const int size = 2 * ctx->layout->room_max_size;
+    for (int ty = 0; ty < g->height; ty += size)
+    {
+        for (int tx = 0; tx < g->width; tx += size)
+        {
+            const SDL_Rect area = { .x = tx,
+                                    .y = ty,
+                                    .w = MIN(size, g->width - tx),
+                                    .h = MIN(size, g->height - ty) };
+            int open = 0;
+            for (int y = area.y; y < area.y + area.h; y++)
+                for (int x = area.x; x < area.x + area.w; x++)
+                    open += !grid_is_wall(g, x, y);
+            if (open >= ctx->layout->room_min_size)
+                ARRAY_PUSH(&ctx->areas, area);
+        }
+    }
+}
+
+static bool build_rooms(gen_ctx* ctx, SDL_Point* anchor)
+{
+    const rg_map_layout* p = ctx->layout;
+    const gen_grid* g = &ctx->grid;
+    rg_rng* rng = ctx->rng;
+    rg_map_rects rooms = { .capacity = p->max_rooms,
+                           .len = 0,
+                           .data = malloc(sizeof(SDL_Rect) * p->max_rooms) };
+    ASSERT_M(rooms.data != NULL);
+    room_index index;
+    room_index_create(&index, g->width, g->height, p->room_max_size);
+
+    for (int r = 0; r < p->max_rooms; r++)
+    {
+        int w = rng_int(rng, p->room_min_size, p->room_max_size);
+        int h = rng_int(rng, p->room_min_size, p->room_max_size);
+        int x = rng_int(rng, 0, g->width - w - 1);
+        int y = rng_int(rng, 0, g->height - h - 1);
+
+        SDL_Rect new_room = { .x = x, .y = y, .w = w, .h = h };
+        if (room_index_intersects(&index, &rooms, &new_room)) continue;
+
+        gen_room(ctx, &new_room);
+        if (rooms.len > 0)
+        {
+            gen_connect(ctx,
+                        room_center(&rooms.data[rooms.len - 1]),
+                        room_center(&new_room));
+        }
+        ARRAY_PUSH(&rooms, new_room);
+        room_index_add(&index, &rooms, (int)rooms.len - 1);
+    }
+    // The rooms are chained, the first one reaches all of them.
+    const bool carved = rooms.len > 0;
+    if (carved) *anchor = room_center(&rooms.data[0]);
+    room_index_destroy(&index);
+    free(rooms.data);
+    return carved;
+}
+
+// Splits the leaf until it can't hold two rooms, places one room per leaf and
+// joins the two halves of every split. Returns a floor cell of the subtree.
+static SDL_Point bsp_leaf(gen_ctx* ctx, SDL_Rect leaf)
+{
+    const rg_map_layout* p = ctx->layout;
+    rg_rng* rng = ctx->rng;
+    // A room needs one more cell for its far wall.
+    const int min_leaf = p->room_min_size + 1;
+    // Leaves stay about twice the room size so the room count is close to
+    // the rooms generator's.
+    const int max_leaf = 2 * p->room_max_size;
+    const bool split_w = leaf.w >= 2 * min_leaf && leaf.w > max_leaf;
+    const bool split_h = leaf.h >= 2 * min_leaf && leaf.h > max_leaf;
+    if (!split_w && !split_h)
+    {
+        const int max_w = MIN(p->room_max_size, leaf.w - 1);
+        const int max_h = MIN(p->room_max_size, leaf.h - 1);
+        const int w = rng_int(rng, p->room_min_size, max_w);
+        const int h = rng_int(rng, p->room_min_size, max_h);
+        const SDL_Rect room = {
+            .x = rng_int(rng, leaf.x, leaf.x + leaf.w - w - 1),
+            .y = rng_int(rng, leaf.y, leaf.y + leaf.h - h - 1),
+            .w = w,
+            .h = h,
+        };
+        gen_room(ctx, &room);
+        return room_center(&room);
+    }
+
+    bool vertical = split_w;
+    if (split_w && split_h)
+    {
+        vertical = leaf.w != leaf.h ? leaf.w > leaf.h : rng_int(rng, 0, 1);
+    }
+    SDL_Rect a = leaf;
+    SDL_Rect b = leaf;
+    if (vertical)
+    {
+        a.w = rng_int(rng, min_leaf, leaf.w - min_leaf);
+        b.x += a.w;
+        b.w -= a.w;
+    }
+    else
+    {
+        a.h = rng_int(rng, min_leaf, leaf.h - min_leaf);
+        b.y += a.h;
+        b.h -= a.h;
+    }
+    const SDL_Point pa = bsp_leaf(ctx, a);
+    const SDL_Point pb = bsp_leaf(ctx, b);
+    gen_connect(ctx, pa, pb);
+    return rng_int(rng, 0, 1) ? pa : pb;
+}
+
+static bool build_bsp(gen_ctx* ctx, SDL_Point* anchor)
+{
+    const gen_grid* g = &ctx->grid;
+    const int min_size = ctx->layout->room_min_size;
+    if (g->width <= min_size || g->height <= min_size) return false;
+    *anchor = bsp_leaf(
+      ctx, (SDL_Rect){ .x = 0, .y = 0, .w = g->width, .h = g->height });
+    return true;
+}
+
+static bool build_drunkard(gen_ctx* ctx, SDL_Point* anchor)
+{
+    gen_grid* g = &ctx->grid;
+    const long target = (long)(g->width - 2) * (g->height - 2) *
+                        DRUNKARD_FLOOR_PERCENT / 100;
+    const long max_steps = target * 50;
+    int x = g->width / 2;
+    int y = g->height / 2;
+    long open = 0;
+    for (long step = 0; open < target && step < max_steps; step++)
+    {
+        if (grid_is_wall(g, x, y))
+        {
+            grid_set(g, x, y, false);
+            open++;
+        }
+        switch (rng_int(ctx->rng, 0, 3))
+        {
+        case 0: x++; break;
+        case 1: x--; break;
+        case 2: y++; break;
+        default: y--; break;
+        }
+        // The border stays solid.
+        x = MAX(1, MIN(x, g->width - 2));
+        y = MAX(1, MIN(y, g->height - 2));
+    }
+    // The walk started there, everything it opened is connected to it.
+    *anchor = (SDL_Point){ .x = g->width / 2, .y = g->height / 2 };
+    return open > 0;
+}
+
+// One step of the 4-5 rule: a cell becomes wall when at least 5 cells of its
+// 3x3 block, itself included, are walls. Works on 64 cells at a time with
+// bit-sliced adders: every row is first summed horizontally into two bit
+// planes, then three row sums are added vertically. The loops are plain
+// word-wise logic without branches so the compiler can vectorize them.
+static void caves_smooth(const gen_grid* src, gen_grid* dst, uint64_t* sums)
+{
+    const int stride = src->stride;
+    uint64_t* lo = sums;
+    uint64_t* hi = sums + (size_t)stride * src->height;
+    for (int y = 0; y < src->height; y++)
+    {
+        const uint64_t* row = grid_row(src, y);
+        uint64_t* l = &lo[y * stride];
+        uint64_t* h = &hi[y * stride];
+        for (int i = 0; i < stride; i++)
+        {
+            const uint64_t prev = i > 0 ? row[i - 1] : ~0ull;
+            const uint64_t next = i + 1 < stride ? row[i + 1] : ~0ull;
+            const uint64_t m = row[i];
+            const uint64_t w = (m << 1) | (prev >> 63);
+            const uint64_t e = (m >> 1) | (next << 63);
+            l[i] = w ^ m ^ e;
+            h[i] = (w & m) | (w & e) | (m & e);
+        }
+    }
+
+    const int pad = src->width & 63;
+    const uint64_t pad_mask = pad != 0 ? ~0ull << pad : 0;
+    const int last = src->width - 1;
+    memset(grid_row(dst, 0), 0xff, sizeof(uint64_t) * stride);
+    memset(grid_row(dst, src->height - 1), 0xff, sizeof(uint64_t) * stride);
+    for (int y = 1; y < src->height - 1; y++)
+    {
+        const uint64_t* a0 = &lo[(y - 1) * stride];
+        const uint64_t* a1 = &hi[(y - 1) * stride];
+        const uint64_t* b0 = &lo[y * stride];
+        const uint64_t* b1 = &hi[y * stride];
+        const uint64_t* c0 = &lo[(y + 1) * stride];
+        const uint64_t* c1 = &hi[(y + 1) * stride];
+        uint64_t* out = grid_row(dst, y);
+        for (int i = 0; i < stride; i++)
+        {
+            // a + b, at most 6
+            const uint64_t x0 = a0[i] ^ b0[i];
+            const uint64_t k0 = a0[i] & b0[i];
+            const uint64_t x1 = a1[i] ^ b1[i] ^ k0;
+            const uint64_t x2 = (a1[i] & b1[i]) | (k0 & (a1[i] ^ b1[i]));
+            // + c, at most 9
+            const uint64_t y0 = x0 ^ c0[i];
+            const uint64_t k1 = x0 & c0[i];
+            const uint64_t y1 = x1 ^ c1[i] ^ k1;
+            const uint64_t k2 = (x1 & c1[i]) | (k1 & (x1 ^ c1[i]));
+            const uint64_t y2 = x2 ^ k2;
+            const uint64_t y3 = x2 & k2;
+            out[i] = y3 | (y2 & (y1 | y0));
+        }
+        out[0] |= 1;
+        out[last >> 6] |= 1ull << (last & 63);
+        out[stride - 1] |= pad_mask;
+    }
+}
+
+// Walls off every open region but the largest, so the chunk is connected.
+// Returns a cell of the region kept, -1 when there is no open cell.
+static int caves_keep_largest(gen_grid* g)
+{
+    const int len = g->width * g->height;
+    int* region = calloc(len, sizeof(*region));
+    int* stack = malloc(sizeof(*stack) * len);
+    ASSERT_M(region != NULL && stack != NULL);
+    int regions = 0;
+    int best = 0;
+    int best_size = 0;
+    int best_start = -1;
+    for (int start = 0; start < len; start++)
+    {
+        if (region[start] != 0) continue;
+        if (grid_is_wall(g, start % g->width, start / g->width)) continue;
+        regions++;
+        int size = 0;
+        int top = 0;
+        stack[top++] = start;
+        region[start] = regions;
+        while (top > 0)
+        {
+            const int i = stack[--top];
+            size++;
+            // Open cells never sit on the border, neighbors are in bounds.
+            const int next[4] = { i - 1, i + 1, i - g->width, i + g->width };
+            for (int n = 0; n < 4; n++)
+            {
+                const int j = next[n];
+                if (region[j] != 0) continue;
+                if (grid_is_wall(g, j % g->width, j / g->width)) continue;
+                region[j] = regions;
+                stack[top++] = j;
+            }
+        }
+        if (size > best_size)
+        {
+            best = regions;
+            best_size = size;
+            best_start = start;
+        }
+    }
+    for (int i = 0; i < len; i++)
+    {
+        if (region[i] != 0 && region[i] != best)
+            grid_set(g, i % g->width, i / g->width, true);
+    }
+    free(stack);
+    free(region);
+    return best_start;
+}
+
+static bool build_caves(gen_ctx* ctx, SDL_Point* anchor)
+{
+    gen_grid* g = &ctx->grid;
+    const uint64_t threshold = UINT64_MAX / 100 * CAVE_FILL_PERCENT;
+    for (int y = 1; y < g->height - 1; y++)
+    {
+        for (int x = 1; x < g->width - 1; x++)
+        {
+            if (rng_next(ctx->rng) >= threshold) grid_set(g, x, y, false);
+        }
+    }
+
+    gen_grid tmp;
+    grid_create(&tmp, g->width, g->height);
+    uint64_t* sums = malloc(sizeof(*sums) * 2 * g->stride * g->height);
+    ASSERT_M(sums != NULL);
+    for (int i = 0; i < CAVE_ITERATIONS; i++)
+    {
+        caves_smooth(g, &tmp, sums);
+        uint64_t* bits = g->bits;
+        g->bits = tmp.bits;
+        tmp.bits = bits;
+    }
+    free(sums);
+    grid_destroy(&tmp);
+
+    const int cell = caves_keep_largest(g);
+    if (cell == -1) return false;
+    *anchor = (SDL_Point){ .x = cell % g->width, .y = cell / g->width };
+    return true;
+}
+
+// Free floor cells of a spawn area, one bit per cell. Spawns draw from it
+// without replacement so they never collide and never get dropped.
+typedef struct room_cells
+{
+    int x, y;
+    int width, height;
+    int free;
+    uint64_t* bits;
+} room_cells;
+
+static int popcount64(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+static void room_cells_create(room_cells* c,
+                              const gen_grid* g,
+                              const SDL_Rect* area)
+{
+    c->x = area->x;
+    c->y = area->y;
+    c->width = area->w;
+    c->height = area->h;
+    c->free = 0;
+    const int len = c->width * c->height;
+    c->bits = calloc((len + 63) / 64, sizeof(*c->bits));
+    ASSERT_M(c->bits != NULL);
+    for (int i = 0; i < len; i++)
+    {
+        if (grid_is_wall(g, c->x + i % c->width, c->y + i / c->width))
+            continue;
+        c->bits[i / 64] |= 1ull << (i % 64);
+        c->free++;
+    }
+}
+
+static void room_cells_destroy(room_cells* c)
+{
+    free(c->bits);
+}
+
+static void room_cells_reserve(room_cells* c, int x, int y)
+{
+    int idx = (x - c->x) + (y - c->y) * c->width;
+    ASSERT_M(idx >= 0 && idx < c->width * c->height);
+    uint64_t mask = 1ull << (idx % 64);
+    if (c->bits[idx / 64] & mask)
+    {
+        c->bits[idx / 64] &= ~mask;
+        c->free--;
+    }
+}
+
+static bool room_cells_take(room_cells* c, rg_rng* rng, int* x, int* y)
+{
+    if (c->free == 0) return false;
+    int k = rng_int(rng, 0, c->free - 1);
+    int word = 0;
+    int n = popcount64(c->bits[0]);
+    while (k >= n)
+    {
+        k -= n;
+        n = popcount64(c->bits[++word]);
+    }
+    uint64_t bits = c->bits[word];
+    for (; k > 0; k--) bits &= bits - 1; // drop the k lowest set bits
+    int bit = 0;
+    while (!(bits & (1ull << bit))) bit++;
+
+    int idx = word * 64 + bit;
+    *x = c->x + idx % c->width;
+    *y = c->y + idx / c->width;
+    c->bits[word] &= ~(1ull << bit);
+    c->free--;
+    return true;
+}
+
+// The center of the area if it is open, any free cell otherwise.
+static bool room_cells_anchor(room_cells* c,
+                              const gen_grid* g,
+                              rg_rng* rng,
+                              int* x,
+                              int* y)
+{
+    *x = c->x + c->width / 2;
+    *y = c->y + c->height / 2;
+    if (grid_is_wall(g, *x, *y)) return room_cells_take(c, rng, x, y);
+    room_cells_reserve(c, *x, *y);
+    return true;
+}
+
+static void room_cells_spawn(room_cells* c,
+                             const rg_spawn_tables* spawns,
+                             rg_rng* rng,
+                             SDL_Point origin,
+                             rg_entity_array* entities,
+                             rg_items* items)
+{
+    int x, y;
+    for (int i = 0; i < spawns->monsters_per_room; i++)
+    {
+        int proto = alias_sampler_draw(&spawns->monsters, rng);
+        if (proto == -1) break;
+        if (!room_cells_take(c, rng, &x, &y)) break;
+        rg_entity monster;
+        entity_create(&monster, proto, origin.x + x, origin.y + y);
+        ARRAY_PUSH(entities, monster);
+    }
+    for (int i = 0; i < spawns->items_per_room; i++)
+    {
+        int proto = alias_sampler_draw(&spawns->items, rng);
+        if (proto == -1) break;
+        if (!room_cells_take(c, rng, &x, &y)) break;
+        ARRAY_PUSH(items,
+                   ((rg_item){
+                     .x = origin.x + x, .y = origin.y + y, .proto = proto }));
+    }
+}
+
+// The player starts in the first area of the start chunk and the stairs go
+// in the last area of the exit chunk, every other area gets monsters and
+// items. Below the first level the up stairs are under the player.
+static void gen_populate(gen_ctx* ctx,
+                         const rg_spawn_tables* spawns,
+                         bool start,
+                         bool exit,
+                         rg_entity_array* entities,
+                         rg_items* items,
+                         rg_entity_id player)
+{
+    const SDL_Point o = ctx->origin;
+    SDL_Point stairs = { 0 };
+    for (size_t i = 0; i < ctx->areas.len; i++)
+    {
+        room_cells cells;
+        room_cells_create(&cells, &ctx->grid, &ctx->areas.data[i]);
+        int x, y;
+        const bool arrival = start && i == 0;
+        if (arrival)
+        {
+            bool placed =
+              room_cells_anchor(&cells, &ctx->grid, ctx->rng, &x, &y);
+            ASSERT_M(placed);
+            entities->data[player].x = o.x + x;
+            entities->data[player].y = o.y + y;
+            stairs = (SDL_Point){ .x = o.x + x, .y = o.y + y };
+        }
+        if (exit && i == ctx->areas.len - 1)
+        {
+            // Shares the player's area when there is only one, and ends up
+            // under the player if that is full.
+            bool placed =
+              arrival ? room_cells_take(&cells, ctx->rng, &x, &y)
+                      : room_cells_anchor(&cells, &ctx->grid, ctx->rng, &x, &y);
+            ASSERT_M(placed || arrival);
+            if (placed) stairs = (SDL_Point){ .x = o.x + x, .y = o.y + y };
+        }
+        if (!arrival)
+            room_cells_spawn(&cells, spawns, ctx->rng, o, entities, items);
+        room_cells_destroy(&cells);
+    }
+
+    rg_entity e;
+    if (exit)
+    {
+        entity_create(&e, ENTITY_PROTO_STAIRS, stairs.x, stairs.y);
+        ARRAY_PUSH(entities, e);
+    }
+    if (start && ctx->map->level > 1)
+    {
+        // The way back up is where the player arrives.
+        const rg_entity* p = &entities->data[player];
+        entity_create(&e, ENTITY_PROTO_STAIRS_UP, p->x, p->y);
+        ARRAY_PUSH(entities, e);
+    }
+}
+
+// Seed of one chunk or edge, so each can be generated on its own.
+static uint64_t gen_seed(const rg_map_layout* layout, uint64_t key)
+{
+    return layout->seed ^ ((key + 1) * 0xd1b54a32d192ed03ull);
+}
+
+// Where the passage between two chunks crosses their shared edge of `len`
+// cells. Both chunks draw the same cell from the edge's seed.
+static int gen_portal(const rg_map_layout* layout, uint64_t edge, int len)
+{
+    rg_rng rng;
+    rng_seed(&rng, gen_seed(layout, edge));
+    return rng_int(&rng, 1, len - 2);
+}
+
+// Tunnels from the anchor to the portal of every edge shared with another
+// chunk. Tunnels stop one cell inside, only the portals open the border.
+static void gen_portals(gen_ctx* ctx, int cx, int cy, SDL_Point anchor)
+{
+    const rg_map* m = ctx->map;
+    const rg_map_layout* l = ctx->layout;
+    gen_grid* g = &ctx->grid;
+    // Every chunk owns the edges east and south of it.
+    const uint64_t east = 3 * (uint64_t)(cx + cy * m->chunks_wide) + 1;
+    const uint64_t south = east + 1;
+    SDL_Point portals[4];
+    int len = 0;
+    if (cx + 1 < m->chunks_wide)
+    {
+        portals[len++] = (SDL_Point){
+            .x = g->width - 1, .y = gen_portal(l, east, g->height)
+        };
+    }
+    if (cx > 0)
+    {
+        portals[len++] = (SDL_Point){
+            .x = 0, .y = gen_portal(l, east - 3, g->height)
+        };
+    }
+    if (cy + 1 < m->chunks_high)
+    {
+        portals[len++] = (SDL_Point){
+            .x = gen_portal(l, south, g->width), .y = g->height - 1
+        };
+    }
+    if (cy > 0)
+    {
+        const uint64_t above = south - 3 * (uint64_t)m->chunks_wide;
+        portals[len++] = (SDL_Point){
+            .x = gen_portal(l, above, g->width), .y = 0
+        };
+    }
+    for (int i = 0; i < len; i++)
+    {
+        const SDL_Point p = portals[i];
+        const SDL_Point inside = { .x = MAX(1, MIN(p.x, g->width - 2)),
+                                   .y = MAX(1, MIN(p.y, g->height - 2)) };
+        gen_connect(ctx, anchor, inside);
+        grid_set(g, p.x, p.y, false);
+    }
+}
+
+// Carves the open cells of the grid into the map, a run at a time.
+static void gen_write(gen_ctx* ctx)
+{
+    const gen_grid* g = &ctx->grid;
+    const SDL_Point o = ctx->origin;
+    for (int y = 0; y < g->height; y++)
+    {
+        int x = 0;
+        while (x < g->width)
+        {
+            if (grid_is_wall(g, x, y))
+            {
+                x++;
+                continue;
+            }
+            const int start = x;
+            while (x < g->width && !grid_is_wall(g, x, y)) x++;
+            map_carve_row(ctx->map, o.y + y, o.x + start, o.x + x);
+        }
+    }
+}
+
+// Generates chunk (cx, cy) into the map and spawns what lives in it.
+static void gen_chunk(rg_map* m,
+                      int cx,
+                      int cy,
+                      const rg_spawn_tables* spawns,
+                      rg_entity_array* entities,
+                      rg_items* items,
+                      rg_entity_id player)
+{
+    const rg_map_layout* l = &m->layout;
+    rg_rng rng;
+    rng_seed(&rng, gen_seed(l, 3 * (uint64_t)(cx + cy * m->chunks_wide)));
+    gen_ctx ctx = { .map = m, .layout = l, .rng = &rng };
+    ctx.origin = (SDL_Point){ .x = cx << MAP_CHUNK_SHIFT,
+                              .y = cy << MAP_CHUNK_SHIFT };
+    grid_create(&ctx.grid,
+                MIN(MAP_CHUNK_SIZE, m->width - ctx.origin.x),
+                MIN(MAP_CHUNK_SIZE, m->height - ctx.origin.y));
+    ctx.areas.capacity = 16;
+    ctx.areas.data = malloc(sizeof(*ctx.areas.data) * ctx.areas.capacity);
+    ASSERT_M(ctx.areas.data != NULL);
+
+    const rg_map_generator* gen = &generators[l->kind];
+    SDL_Point anchor;
+    SDL_Rect fallback;
+    if (gen->build(&ctx, &anchor))
+    {
+        fallback = (SDL_Rect){ .x = anchor.x, .y = anchor.y, .w = 1, .h = 1 };
+    }
+    else
+    {
+        // Nothing usable came out, there is still a room to stand in.
+        const int size = MIN(l->room_min_size,
+                             MIN(ctx.grid.width, ctx.grid.height) - 2);
+        fallback = (SDL_Rect){ .x = (ctx.grid.width - size) / 2,
+                               .y = (ctx.grid.height - size) / 2,
+                               .w = size,
+                               .h = size };
+        gen_carve(&ctx, fallback.x, fallback.y, fallback.w, fallback.h);
+        anchor = room_center(&fallback);
+    }
+    gen_portals(&ctx, cx, cy, anchor);
+    map_chunk_build(m, cx, cy);
+    gen_write(&ctx);
+    gen->finish(&ctx);
+    // The player and the stairs always find a place.
+    if (ctx.areas.len == 0) ARRAY_PUSH(&ctx.areas, fallback);
+
+    gen_populate(&ctx,
+                 spawns,
+                 cx == l->start.x && cy == l->start.y,
+                 cx == l->exit.x && cy == l->exit.y,
+                 entities,
+                 items,
+                 player);
+    grid_destroy(&ctx.grid);
+    free(ctx.areas.data);
+}
+
+void map_generate(rg_map* m,
+                  rg_map_gen_kind kind,
+                  const rg_map_gen_params* params,
+                  rg_rng* rng,
+                  rg_entity_array* entities,
+                  rg_items* items,
+                  rg_entity_id player)
+{
+    ASSERT_M(kind < MAP_GEN_LEN);
+    map_alloc(m, params->width, params->height, params->level);
+    rg_map_layout* l = &m->layout;
+    l->kind = kind;
+    l->seed = rng_next(rng);
+    l->room_min_size = params->room_min_size;
+    l->room_max_size = params->room_max_size;
+    l->max_rooms = params->max_rooms;
+
+    // The stairs down are in another chunk whenever there is one.
+    const int chunks = m->chunks_wide * m->chunks_high;
+    const int start = rng_int(rng, 0, chunks - 1);
+    int exit = start;
+    if (chunks > 1)
+    {
+        exit = rng_int(rng, 0, chunks - 2);
+        if (exit >= start) exit++;
+    }
+    l->start = (SDL_Point){ .x = start % m->chunks_wide,
+                            .y = start / m->chunks_wide };
+    l->exit = (SDL_Point){ .x = exit % m->chunks_wide,
+                           .y = exit / m->chunks_wide };
+
+    rg_spawn_tables spawns;
+    spawn_tables_compile(&spawns, params->level);
+    gen_chunk(m, l->start.x, l->start.y, &spawns, entities, items, player);
+    spawn_tables_destroy(&spawns);
+
+    const rg_entity* p = &entities->data[player];
+    map_generate_near(m, p->x, p->y, entities, items, player);
+}
+
+bool map_generate_near(rg_map* m,
+                       int x,
+                       int y,
+                       rg_entity_array* entities,
+                       rg_items* items,
+                       rg_entity_id player)
+{
+    const int pcx = x >> MAP_CHUNK_SHIFT;
+    const int pcy = y >> MAP_CHUNK_SHIFT;
+    rg_spawn_tables spawns;
+    bool generated = false;
+    for (int cy = MAX(0, pcy - GEN_NEAR);
+         cy <= MIN(m->chunks_high - 1, pcy + GEN_NEAR);
+         cy++)
+    {
+        for (int cx = MAX(0, pcx - GEN_NEAR);
+             cx <= MIN(m->chunks_wide - 1, pcx + GEN_NEAR);
+             cx++)
+        {
+            if (map_chunk_is_built(m, cx, cy)) continue;
+            if (!generated) spawn_tables_compile(&spawns, m->level);
+            generated = true;
+            gen_chunk(m, cx, cy, &spawns, entities, items, player);
+        }
+    }
+    if (generated) spawn_tables_destroy(&spawns);
+    return generated;
+}
@@ -0,0 +1,54 @@
+#ifndef MAP_GEN_H
+#define MAP_GEN_H
+
+#include "entity.h"
+#include "game_map.h"
+#include "items.h"
+#include "rng.h"
+
+typedef enum rg_map_gen_kind
+{
+    MAP_GEN_ROOMS,    // random rooms joined by tunnels
+    MAP_GEN_BSP,      // binary space partition, one room per leaf
+    MAP_GEN_DRUNKARD, // random walk carving
+    MAP_GEN_CAVES,    // cellular automata caves
+
+    MAP_GEN_LEN,
+} rg_map_gen_kind;
+
+typedef struct rg_map_gen_params
+{
+    int width;
+    int height;
+    int level;
+    int room_min_size;
+    int room_max_size;
+    int max_rooms; // per chunk
+} rg_map_gen_params;
+
+rg_map_gen_kind map_gen_for_level(int level);
+const char* map_gen_name(rg_map_gen_kind kind);
+
+// Lays out a new map and generates the chunks around the start, the player
+// is moved there. The rest is generated by map_generate_near as the player
+// comes close, the stairs down are spawned with the chunk holding them and
+// the up stairs below the first level are under the player.
+void map_generate(rg_map* m,
+                  rg_map_gen_kind kind,
+                  const rg_map_gen_params* params,
+                  rg_rng* rng,
+                  rg_entity_array* entities,
+                  rg_items* items,
+                  rg_entity_id player);
+
+// Generates the chunks around (x, y) that weren't yet and appends what
+// spawns in them to `entities` and `items`. Returns true when any chunk was
+// generated.
+bool map_generate_near(rg_map* m,
+                       int x,
+                       int y,
+                       rg_entity_array* entities,
+                       rg_items* items,
+                       rg_entity_id player);
+
+#endif
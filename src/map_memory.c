@@ -0,0 +1,141 @@
+#include "map_memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "color.h"
+#include "types.h"
+
+#define MEMORY_CHUNK_CELLS (MAP_CHUNK_SIZE * MAP_CHUNK_SIZE)
+
+void map_memory_create(rg_map_memory* mm, const rg_map* m)
+{
+    memset(mm, 0, sizeof(*mm));
+    mm->chunks_wide = m->chunks_wide;
+    mm->chunks_high = m->chunks_high;
+    const int len = mm->chunks_wide * mm->chunks_high;
+    mm->chunks = calloc(len, sizeof(*mm->chunks));
+    ASSERT_M(mm->chunks != NULL);
+}
+
+static void memory_chunk_drop(rg_map_memory* mm, int idx)
+{
+    free(mm->chunks[idx]);
+    mm->chunks[idx] = NULL;
+}
+
+void map_memory_destroy(rg_map_memory* mm)
+{
+    if (mm->chunks != NULL)
+    {
+        for (int i = 0; i < mm->chunks_wide * mm->chunks_high; i++)
+            memory_chunk_drop(mm, i);
+    }
+    free(mm->chunks);
+    memset(mm, 0, sizeof(*mm));
+}
+
+static int memory_index(int x, int y)
+{
+    return (x & MAP_CHUNK_MASK) + (y & MAP_CHUNK_MASK) * MAP_CHUNK_SIZE;
+}
+
+// What an explored cell looks like out of sight, `mc` is the map chunk
+// holding it.
+static void memory_cell(rg_console_cell* cells,
+                        const rg_map_chunk* mc,
+                        int x,
+                        int y)
+{
+    rg_console_cell* cell = &cells[memory_index(x, y)];
+    cell->ch = -1;
+    cell->fg = DARK_GREY;
+    cell->bg = BLACK;
+    if (!map_chunk_get(mc, MAP_PLANE_EXPLORED, x, y)) return;
+    const rg_tile_type type = map_chunk_type(mc, x, y);
+    if (type == TILE_DOOR_CLOSED)
+        cell->ch = '+';
+    else if (type == TILE_DOOR_OPEN)
+        cell->ch = '\'';
+    else if (map_chunk_get(mc, MAP_PLANE_BLOCK_SIGHT, x, y))
+        cell->ch = '#';
+}
+
+// Builds the chunk's cells from the explored plane.
+static rg_console_cell* memory_chunk_fetch(rg_map_memory* mm,
+                                          rg_map* m,
+                                          int cx,
+                                          int cy)
+{
+    const int idx = cx + cy * mm->chunks_wide;
+    if (mm->chunks[idx] != NULL) return mm->chunks[idx];
+
+    rg_console_cell* cells = malloc(sizeof(*cells) * MEMORY_CHUNK_CELLS);
+    ASSERT_M(cells != NULL);
+    const rg_console_cell blank = { .ch = -1, .fg = BLACK, .bg = BLACK };
+    for (int i = 0; i < MEMORY_CHUNK_CELLS; i++) cells[i] = blank;
+    const int x0 = cx << MAP_CHUNK_SHIFT;
+    const int y0 = cy << MAP_CHUNK_SHIFT;
+    const int x1 = MIN(x0 + MAP_CHUNK_SIZE, m->width);
+    const int y1 = MIN(y0 + MAP_CHUNK_SIZE, m->height);
+    const rg_map_chunk* mc = map_chunk_fetch(m, cx, cy);
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) memory_cell(cells, mc, x, y);
+    mm->chunks[idx] = cells;
+    return cells;
+}
+
+// Records how a cell in view looks now, for when it is out of sight again.
+void map_memory_remember(rg_map_memory* mm, rg_map* m, int x, int y)
+{
+    const int cx = x >> MAP_CHUNK_SHIFT;
+    const int cy = y >> MAP_CHUNK_SHIFT;
+    memory_cell(memory_chunk_fetch(mm, m, cx, cy),
+                map_chunk_fetch(m, cx, cy),
+                x,
+                y);
+}
+
+// Copies the remembered cells in `view`, given in map cells, to the top left
+// of the console. Chunks well outside the view are dropped.
+void map_memory_draw(rg_map_memory* mm,
+                     rg_map* m,
+                     const SDL_Rect* view,
+                     rg_console* c)
+{
+    const int cx0 = view->x >> MAP_CHUNK_SHIFT;
+    const int cy0 = view->y >> MAP_CHUNK_SHIFT;
+    const int cx1 = (view->x + view->w - 1) >> MAP_CHUNK_SHIFT;
+    const int cy1 = (view->y + view->h - 1) >> MAP_CHUNK_SHIFT;
+    for (int cy = 0; cy < mm->chunks_high; cy++)
+    {
+        for (int cx = 0; cx < mm->chunks_wide; cx++)
+        {
+            const int idx = cx + cy * mm->chunks_wide;
+            if (cx < cx0 - 1 || cx > cx1 + 1 || cy < cy0 - 1 || cy > cy1 + 1)
+            {
+                memory_chunk_drop(mm, idx);
+                continue;
+            }
+            if (cx < cx0 || cx > cx1 || cy < cy0 || cy > cy1) continue;
+
+            const rg_console_cell* cells = memory_chunk_fetch(mm, m, cx, cy);
+            const SDL_Rect chunk = { .x = cx << MAP_CHUNK_SHIFT,
+                                     .y = cy << MAP_CHUNK_SHIFT,
+                                     .w = MAP_CHUNK_SIZE,
+                                     .h = MAP_CHUNK_SIZE };
+            SDL_Rect r;
+            if (!SDL_IntersectRect(&chunk, view, &r)) continue;
+            for (int y = r.y; y < r.y + r.h; y++)
+            {
+                const int sy = y - view->y;
+                const int sx = r.x - view->x;
+                if (sy >= c->height || sx >= c->width) continue;
+                const int n = MIN(r.w, c->width - sx);
+                memcpy(&c->cells[sx + sy * c->width],
+                       &cells[memory_index(r.x, y)],
+                       sizeof(*cells) * n);
+            }
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef MAP_MEMORY_H
+#define MAP_MEMORY_H
+
+#include <SDL.h>
+
+#include "console.h"
+#include "game_map.h"
+
+// Remembered terrain, kept as console cells per map chunk until the chunk
+// scrolls far off screen. A cell is only redrawn when what the player last
+// saw of it changes, the frame copies the rows in view under the live cells.
+typedef struct rg_map_memory
+{
+    int chunks_wide;
+    int chunks_high;
+    rg_console_cell** chunks; // NULL while not built
+} rg_map_memory;
+
+void map_memory_create(rg_map_memory* mm, const rg_map* m);
+void map_memory_destroy(rg_map_memory* mm);
+
+void map_memory_remember(rg_map_memory* mm, rg_map* m, int x, int y);
+void map_memory_draw(rg_map_memory* mm,
+                     rg_map* m,
+                     const SDL_Rect* view,
+                     rg_console* c);
+
+#endif
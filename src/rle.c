@@ -0,0 +1,62 @@
+#include "rle.h"
+
+#include <string.h>
+
+#include "array.h"
+#include "types.h"
+
+// PackBits style: a control byte below 128 is followed by that many plus one
+// literal bytes, otherwise the next byte is repeated control - 126 times.
+void rle_encode(rg_bytes* out, const uint8_t* src, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t run = 1;
+        while (i + run < len && run < 129 && src[i + run] == src[i]) run++;
+        if (run >= 2)
+        {
+            ARRAY_PUSH(out, (uint8_t)(run + 126));
+            ARRAY_PUSH(out, src[i]);
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of two.
+        size_t lit = 1;
+        while (i + lit < len && lit < 128 &&
+               !(i + lit + 1 < len && src[i + lit] == src[i + lit + 1]))
+            lit++;
+        ARRAY_PUSH(out, (uint8_t)(lit - 1));
+        for (size_t k = 0; k < lit; k++) ARRAY_PUSH(out, src[i + k]);
+        i += lit;
+    }
+}
+
+size_t rle_decode(const rg_bytes* in,
+                         size_t pos,
+                         uint8_t* dst,
+                         size_t len)
+{
+    size_t n = 0;
+    while (n < len)
+    {
+        ASSERT_M(pos < in->len);
+        const uint8_t ctl = in->data[pos++];
+        if (ctl < 128)
+        {
+            const size_t lit = ctl + 1u;
+            ASSERT_M(n + lit <= len && pos + lit <= in->len);
+            memcpy(dst + n, in->data + pos, lit);
+            pos += lit;
+            n += lit;
+        }
+        else
+        {
+            const size_t run = ctl - 126u;
+            ASSERT_M(n + run <= len && pos < in->len);
+            memset(dst + n, in->data[pos++], run);
+            n += run;
+        }
+    }
+    return pos;
+}
@@ -0,0 +1,19 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct rg_bytes
+{
+    size_t len;
+    size_t capacity;
+    uint8_t* data;
+} rg_bytes;
+
+// Appends `len` bytes of `src` to `out`, which needs a capacity of at least 1.
+void rle_encode(rg_bytes* out, const uint8_t* src, size_t len);
+// Decodes exactly `len` bytes starting at `pos`, returns the position after.
+size_t rle_decode(const rg_bytes* in, size_t pos, uint8_t* dst, size_t len);
+
+#endif
@@ -0,0 +1,87 @@
+#include "rng.h"
+
+#include "types.h"
+
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(rg_rng* r, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++) r->s[i] = splitmix64(&seed);
+}
+
+uint64_t rng_next(rg_rng* r)
+{
+    uint64_t* s = r->s;
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Hands the current sequence to `out` and moves `r` 2^128 draws ahead, so the
+// two never overlap.
+void rng_split(rg_rng* r, rg_rng* out)
+{
+    static const uint64_t jump[] = { 0x180ec6d33cfd0abaull,
+                                     0xd5a61266f0c9392cull,
+                                     0xa9582618e03fc9aaull,
+                                     0x39abdc4529b1661cull };
+    *out = *r;
+    uint64_t s[4] = { 0 };
+    for (int i = 0; i < 4; i++)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            if (jump[i] & (1ull << b))
+            {
+                for (int j = 0; j < 4; j++) s[j] ^= r->s[j];
+            }
+            rng_next(r);
+        }
+    }
+    for (int j = 0; j < 4; j++) r->s[j] = s[j];
+}
+
+// Uniform in [min, max], without modulo bias.
+int rng_int(rg_rng* r, int min, int max)
+{
+    ASSERT_M(min <= max);
+    const uint64_t range = (uint64_t)((int64_t)max - min) + 1;
+    const uint64_t limit = UINT64_MAX - UINT64_MAX % range;
+    uint64_t v;
+    do
+    {
+        v = rng_next(r);
+    } while (v >= limit);
+    return (int)((int64_t)min + (int64_t)(v % range));
+}
+
+void rng_streams_create(rg_rng_streams* s, uint64_t seed)
+{
+    s->seed = seed;
+    rg_rng root;
+    rng_seed(&root, seed);
+    for (int i = 0; i < RNG_STREAM_LEN; i++) rng_split(&root, &s->streams[i]);
+}
+
+rg_rng* rng_stream(rg_rng_streams* s, rg_rng_stream stream)
+{
+    ASSERT_M(stream < RNG_STREAM_LEN);
+    return &s->streams[stream];
+}
@@ -0,0 +1,37 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// xoshiro256** generator. State objects are independent, so every thread or
+// subsystem can own one without locking.
+typedef struct rg_rng
+{
+    uint64_t s[4];
+} rg_rng;
+
+typedef enum rg_rng_stream
+{
+    RNG_STREAM_MAP,
+    RNG_STREAM_AI,
+
+    RNG_STREAM_LEN,
+} rg_rng_stream;
+
+// One generator per subsystem, all derived from a single seed so a game can
+// be replayed from it.
+typedef struct rg_rng_streams
+{
+    uint64_t seed;
+    rg_rng streams[RNG_STREAM_LEN];
+} rg_rng_streams;
+
+void rng_seed(rg_rng* r, uint64_t seed);
+void rng_split(rg_rng* r, rg_rng* out);
+uint64_t rng_next(rg_rng* r);
+int rng_int(rg_rng* r, int min, int max);
+
+void rng_streams_create(rg_rng_streams* s, uint64_t seed);
+rg_rng* rng_stream(rg_rng_streams* s, rg_rng_stream stream);
+
+#endif
@@ -1,6 +1,7 @@
 #include "savefile.h"
 
 #include <stdbool.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,42 +9,47 @@
 
 #include <SDL.h>
 
+#include "array.h"
 #include "types.h"
 
-#define TEXT_LEN_M "text_len=%zu"
-#define TEXT_M "text="
-const char* fmt_color = "color=[%hhu,%hhu,%hhu,%hhu]";
-const char* fmt_txt = TEXT_LEN_M " " TEXT_M "%s";
-
 const char* fmt_entity_len = "entity_len=%zu";
-const char* fmt_entity = "entity pos=[%d,%d] ch=%c color=[%hhu,%hhu,%hhu,%hhu]";
-const char* fmt_entity_name = " name='%s' ";
-const char* fmt_entity_rem = "blocks=%d type=%d state=[%d, %ld] "
-                             "fighter=[%d,%d,%d,%d,%d] render_order=%d";
+const char* fmt_entity = "entity pos=[%d,%d] proto=%d dead=%d state=[%d, %ld] "
+                         "fighter=[%d,%d,%d,%d,%d]";
 
 const char* fmt_item_len = "item_len=%zu";
-const char* fmt_item = "item pos=[%d,%d] ch=%c color=[%hhu,%hhu,%hhu,%hhu]";
-const char* fmt_item_name = " name='%s' ";
-const char* fmt_item_rem = "visible=%d type=%d";
-const char* fmt_item_heal = " amount=%d";
-const char* fmt_item_lightning = " damage=%d range=%d";
-const char* fmt_item_fireball = " damage=%d radius=%d";
-const char* fmt_item_confuse = " duration=%d";
-const char* fmt_item_equipment =
-  " slot=%d power_bonus=%d defense_bonus=%d max_hp_bonus=%d";
+const char* fmt_item = "item pos=[%d,%d] proto=%d";
 
 const char* fmt_inventory_len = "inventory_len=%zu";
-const char* fmt_inventory = "inventory id=%zu";
 
 const char* fmt_game_map = "map=[%d,%d] level=%d";
-const char* fmt_tile_len = "tile_len=%zu";
-const char* fmt_tile = "tile=[%d,%d,%d]";
+const char* fmt_map_layout_out =
+  "layout kind=%d seed=%" PRIx64 " rooms=[%d,%d,%d] start=[%d,%d] exit=[%d,%d]";
+const char* fmt_map_layout =
+  "layout kind=%d seed=%" SCNx64 " rooms=[%d,%d,%d] start=[%d,%d] exit=[%d,%d]";
+const char* fmt_map_chunks_len = "map_chunks=%d";
+const char* fmt_map_chunk = "chunk=[%d,%d]";
+const char* fmt_map_word = " %" PRIx64;
 
 const char* fmt_player_index = "playerid=%zu";
 const char* fmt_game_state = "game_state=%zu";
 const char* fmt_player_level =
   "level current_level=%d current_xp=%d level_up_base=%d level_up_factor=%d";
 
+// Written with the PRI forms, read back with the SCN ones.
+const char* fmt_rng_seed_out = "rng_seed=%" PRIu64;
+const char* fmt_rng_seed = "rng_seed=%" SCNu64;
+const char* fmt_rng_stream_out =
+  "rng_stream=[%" PRIx64 ",%" PRIx64 ",%" PRIx64 ",%" PRIx64 "]";
+const char* fmt_rng_stream =
+  "rng_stream=[%" SCNx64 ",%" SCNx64 ",%" SCNx64 ",%" SCNx64 "]";
+
+const char* fmt_level_cache_len = "level_cache=%zu";
+const char* fmt_cached_level =
+  "cached_level depth=%d map=[%d,%d] player=[%d,%d] chunks=%zu data=%zu "
+  "entities=%zu items=%zu";
+const char* fmt_cached_entity = "cached_entity pos=[%hd,%hd] proto=%hhu "
+                                "dead=%hhu state=[%hhu,%hhu,%hd] hp=%hd";
+
 const char* fmt_turn_log_len = "log_len=%zu";
 const char* fmt_turn_log =
   "log type=%d color=[%hhu,%hhu,%hhu,%hhu] text_size=%zu";
@@ -57,156 +63,48 @@ char* next_line(char* start)
     return end;
 }
 
-static void add_space(FILE* fp)
-{
-    const char* s = "%c";
-    fprintf(fp, s, ' ');
-}
-
-static void color_save(SDL_Color* c, FILE* fp)
-{
-    fprintf(fp, fmt_color, c->r, c->g, c->b, c->a);
-}
-
-static char* color_load(SDL_Color* c, char* buf)
-{
-    int ret = sscanf(buf, fmt_color, &c->r, &c->g, &c->b, &c->a);
-    ASSERT_M(ret == 4);
-    return strchr(buf, ' ');
-}
-
-static void text_save(const char* txt, FILE* fp)
-{
-    fprintf(fp, fmt_txt, strlen(txt), txt);
-}
-
-static char* text_load(char* txt, char* buf)
-{
-    size_t sz = 0;
-    sscanf_s(buf, TEXT_LEN_M, &sz);
-    char* start = strstr(buf, TEXT_M) + 5;
-    ASSERT_M(start != NULL);
-    memcpy(txt, start, sz);
-    return start + sz;
-}
-
 void entity_save(rg_entity* e, FILE* fp)
 {
     fprintf(fp,
             fmt_entity,
             e->x,
             e->y,
-            e->ch,
-            e->color.r,
-            e->color.g,
-            e->color.b,
-            e->color.a);
-    fprintf(fp, fmt_entity_name, e->name);
-    fprintf(fp,
-            fmt_entity_rem,
-            e->blocks,
-            e->type,
+            e->proto,
+            e->dead,
             e->state.type,
             e->state.data.packed,
             e->fighter.max_hp,
             e->fighter.hp,
             e->fighter.defence,
             e->fighter.power,
-            e->fighter.xp,
-            e->render_order);
+            e->fighter.xp);
 }
 
 void item_save(rg_item* i, FILE* fp)
 {
-    fprintf(fp,
-            fmt_item,
-            i->x,
-            i->y,
-            i->ch,
-            i->color.r,
-            i->color.g,
-            i->color.b,
-            i->color.a);
-    fprintf(fp, fmt_item_name, i->name);
-    fprintf(fp, fmt_item_rem, i->visible_on_map, i->type);
-    switch (i->type)
-    {
-    case ITEM_POTION_HEAL:
-        fprintf(fp, fmt_item_heal, i->heal.amount);
-        break;
-    case ITEM_LIGHTNING:
-        fprintf(fp,
-                fmt_item_lightning,
-                i->lightning.damage,
-                i->lightning.maximum_range);
-        break;
-    case ITEM_FIRE_BALL:
-        fprintf(fp, fmt_item_fireball, i->fireball.damage, i->fireball.radius);
-        add_space(fp);
-        color_save(&i->fireball.targeting_msg_color, fp);
-        add_space(fp);
-        text_save(i->fireball.targeting_msg, fp);
-        add_space(fp);
-        break;
-    case ITEM_CAST_CONFUSE:
-        fprintf(fp, fmt_item_confuse, i->confuse.duration);
-        add_space(fp);
-        color_save(&i->fireball.targeting_msg_color, fp);
-        add_space(fp);
-        text_save(i->fireball.targeting_msg, fp);
-        add_space(fp);
-        break;
-    case ITEM_EQUIPMENT:
-        fprintf(fp,
-                fmt_item_equipment,
-                i->equipable.slot,
-                i->equipable.power_bonus,
-                i->equipable.defense_bonus,
-                i->equipable.max_hp_bonus);
-        add_space(fp);
-        break;
-    default:
-        ASSERT_M(false);
-    }
+    fprintf(fp, fmt_item, i->x, i->y, i->proto);
 }
 
 void entity_load(rg_entity* e, const char* buf)
 {
-    int ret = sscanf(buf,
-                     fmt_entity,
-                     &e->x,
-                     &e->y,
-                     &e->ch,
-                     &e->color.r,
-                     &e->color.g,
-                     &e->color.b,
-                     &e->color.a);
-    ASSERT_M(ret == 7);
-
-    char* nstart = strstr(buf, "name='") + 6;
-    ASSERT_M(nstart != 0);
-    char* nend = strchr(nstart, '\'');
-    size_t sz = nend - nstart;
-    memcpy(e->name, nstart, sz);
-    e->name[sz] = '\0';
-    nend += 2;
-    //"blocks=1 type=0 state=[0, 0] fighter=[30,30,2,5] render_order=1"
-    //"blocks=%d type=%d state=[%d, %ld] fighter=[%d,%d,%d,%d] render_order=%d"
-    int blocks = 0;
-    ret = sscanf_s(nend,
-                   fmt_entity_rem,
-                   &blocks,
-                   &e->type,
-                   &e->state.type,
-                   &e->state.data.packed,
-                   &e->fighter.max_hp,
-                   &e->fighter.hp,
-                   &e->fighter.defence,
-                   &e->fighter.power,
-                   &e->fighter.xp,
-                   &e->render_order);
-    ASSERT_M(ret == 10);
-    e->blocks = blocks;
+    memset(e, 0, sizeof(*e));
+    int dead = 0;
+    int ret = sscanf_s(buf,
+                       fmt_entity,
+                       &e->x,
+                       &e->y,
+                       &e->proto,
+                       &dead,
+                       &e->state.type,
+                       &e->state.data.packed,
+                       &e->fighter.max_hp,
+                       &e->fighter.hp,
+                       &e->fighter.defence,
+                       &e->fighter.power,
+                       &e->fighter.xp);
+    ASSERT_M(ret == 11);
+    ASSERT_M(e->proto < ENTITY_PROTO_LEN);
+    e->dead = dead;
 }
 
 char* entities_load(rg_entity_array* entities, char* buf)
@@ -231,84 +129,11 @@ char* entities_load(rg_entity_array* entities, char* buf)
 
 char* item_load(rg_item* i, const char* buf)
 {
-    memset(i, sizeof(*i), 0);
-    int visible = 0;
-    int ret = sscanf(buf,
-                     fmt_item,
-                     &i->x,
-                     &i->y,
-                     &i->ch,
-                     &i->color.r,
-                     &i->color.g,
-                     &i->color.b,
-                     &i->color.a);
-    ASSERT_M(ret == 7);
-    char* nstart = strstr(buf, "name='") + 6;
-    ASSERT_M(nstart != 0);
-    char* ptr = strchr(nstart, '\'');
-    size_t sz = ptr - nstart;
-    memcpy(i->name, nstart, sz);
-    i->name[sz] = '\0';
-    ptr += 2;
-    ret = sscanf_s(ptr, fmt_item_rem, &visible, &i->type);
-    i->visible_on_map = visible;
-    ptr = strstr(ptr, "type=") + 5 + 1 + 1;
-    ASSERT_M(ret == 2);
-
-    switch (i->type)
-    {
-    case ITEM_POTION_HEAL:
-    {
-        int res = sscanf_s(ptr, fmt_item_heal, &i->heal.amount);
-        ASSERT_M(res == 1);
-        break;
-    }
-    case ITEM_LIGHTNING:
-    {
-
-        int res = sscanf_s(ptr,
-                           fmt_item_lightning,
-                           &i->lightning.damage,
-                           &i->lightning.maximum_range);
-        ASSERT_M(res == 2);
-        break;
-    }
-    case ITEM_FIRE_BALL:
-    {
-        int res = sscanf_s(
-          ptr, fmt_item_fireball, &i->fireball.damage, &i->fireball.radius);
-        ASSERT_M(res == 2);
-        ptr = strstr(ptr, "color=");
-        ptr = color_load(&i->fireball.targeting_msg_color, ptr);
-        ptr++;
-        ptr = text_load((char*)i->fireball.targeting_msg, ptr);
-        break;
-    }
-    case ITEM_CAST_CONFUSE:
-    {
-        int res = sscanf_s(ptr, fmt_item_confuse, &i->confuse.duration);
-        ASSERT_M(res == 1);
-        ptr = strstr(ptr, "color=");
-        ptr = color_load(&i->fireball.targeting_msg_color, ptr);
-        ptr = text_load((char*)i->fireball.targeting_msg, ptr + 1);
-        break;
-    }
-    case ITEM_EQUIPMENT:
-    {
-        int ret = sscanf_s(ptr,
-                           fmt_item_equipment,
-                           &i->equipable.slot,
-                           &i->equipable.power_bonus,
-                           &i->equipable.defense_bonus,
-                           &i->equipable.max_hp_bonus);
-        ASSERT_M(ret == 4);
-        break;
-    }
-    default:
-        ASSERT_M(false);
-    }
-    ptr = next_line(ptr);
-    return ptr;
+    memset(i, 0, sizeof(*i));
+    int ret = sscanf_s(buf, fmt_item, &i->x, &i->y, &i->proto);
+    ASSERT_M(ret == 3);
+    ASSERT_M(i->proto < ITEM_PROTO_LEN);
+    return next_line((char*)buf);
 }
 
 char* items_load(rg_items* items, char* buf)
@@ -333,66 +158,276 @@ char* items_load(rg_items* items, char* buf)
 
 static char* inventory_load(rg_inventory* iv, char* buf)
 {
-    memset(iv, sizeof(*iv), 0);
-    inventory_create(iv, 26);
-    const int ret = sscanf_s(buf, fmt_inventory_len, &iv->len);
+    size_t len = 0;
+    const int ret = sscanf_s(buf, fmt_inventory_len, &len);
     ASSERT_M(ret == 1);
-    if (iv->len == 0) return next_line(buf);
     char* line = next_line(buf);
-    for (size_t i = 0; i < iv->len; i++)
+    for (size_t i = 0; i < len; i++)
     {
-        size_t* it = &iv->data[i];
-        sscanf_s(line, fmt_inventory, it);
-        line = next_line(line);
+        rg_item it;
+        line = item_load(&it, line);
+        if (*line == '\n') line++;
+        inventory_add_item(iv, &it, NULL);
     }
     return line;
 }
 
-static void tile_save(rg_tile* t, FILE* fp)
+static int hex_digit(char c)
 {
-    fprintf(fp, fmt_tile, t->blocked, t->block_sight, t->explored);
+    if (c >= '0' && c <= '9') return c - '0';
+    ASSERT_M(c >= 'a' && c <= 'f');
+    return c - 'a' + 10;
+}
+
+static void map_layout_save(const rg_map_layout* l, FILE* fp)
+{
+    fprintf(fp,
+            fmt_map_layout_out,
+            l->kind,
+            l->seed,
+            l->room_min_size,
+            l->room_max_size,
+            l->max_rooms,
+            l->start.x,
+            l->start.y,
+            l->exit.x,
+            l->exit.y);
+    fprintf(fp, "\n");
+}
+
+static char* map_layout_load(rg_map_layout* l, char* line)
+{
+    int ret = sscanf_s(line,
+                       fmt_map_layout,
+                       &l->kind,
+                       &l->seed,
+                       &l->room_min_size,
+                       &l->room_max_size,
+                       &l->max_rooms,
+                       &l->start.x,
+                       &l->start.y,
+                       &l->exit.x,
+                       &l->exit.y);
+    ASSERT_M(ret == 9);
+    return next_line(line);
 }
 
 static void game_map_save(rg_map* m, FILE* fp)
 {
     fprintf(fp, fmt_game_map, m->width, m->height, m->level);
     fprintf(fp, "\n");
-    fprintf(fp, fmt_tile_len, m->tiles.len);
+    map_layout_save(&m->layout, fp);
+
+    // Chunks that weren't generated yet are generated from the layout when
+    // the player comes close.
+    int len = 0;
+    for (int cy = 0; cy < m->chunks_high; cy++)
+        for (int cx = 0; cx < m->chunks_wide; cx++)
+            len += map_chunk_is_built(m, cx, cy);
+    fprintf(fp, fmt_map_chunks_len, len);
     fprintf(fp, "\n");
-    for (size_t i = 0; i < m->tiles.len; i++)
+    // Evicted chunks are read into the scratch chunk and stay evicted.
+    rg_map_chunk scratch;
+    for (int cy = 0; cy < m->chunks_high; cy++)
     {
-        tile_save(&m->tiles.data[i], fp);
-        fprintf(fp, "\n");
+        for (int cx = 0; cx < m->chunks_wide; cx++)
+        {
+            if (!map_chunk_is_built(m, cx, cy)) continue;
+            const rg_map_chunk* c = map_chunk_peek(m, cx, cy, &scratch);
+            fprintf(fp, fmt_map_chunk, cx, cy);
+            for (int p = 0; p < MAP_PLANE_LEN; p++)
+                for (int y = 0; y < MAP_CHUNK_SIZE; y++)
+                    fprintf(fp, fmt_map_word, c->planes[p][y]);
+            fprintf(fp, "\n");
+            // Tile types are written as one hex digit per cell.
+            for (int i = 0; i < MAP_CHUNK_SIZE * MAP_CHUNK_SIZE; i++)
+                fprintf(fp, "%x", c->types[i]);
+            fprintf(fp, "\n");
+        }
     }
 }
 
 static char* game_map_load(rg_map* m, char* buf)
 {
-    memset(m, sizeof(*m), 0);
-    int ret;
-    ret = sscanf_s(buf, fmt_game_map, &m->width, &m->height, &m->level);
+    int width, height, level;
+    int ret = sscanf_s(buf, fmt_game_map, &width, &height, &level);
     ASSERT_M(ret == 3);
-    char* line = next_line(buf);
-    ret = sscanf_s(line, fmt_tile_len, &m->tiles.len);
-    ASSERT_M(ret == 1);
+    map_alloc(m, width, height, level);
+    char* line = map_layout_load(&m->layout, next_line(buf));
 
+    int chunks_len = 0;
+    ret = sscanf_s(line, fmt_map_chunks_len, &chunks_len);
+    ASSERT_M(ret == 1);
     line = next_line(line);
-    m->tiles.capacity = m->tiles.len;
-    m->tiles.data = malloc(sizeof(*m->tiles.data) * m->tiles.capacity);
-    for (size_t i = 0; i < m->tiles.len; i++)
+    for (int i = 0; i < chunks_len; i++)
+    {
+        int cx, cy;
+        ret = sscanf_s(line, fmt_map_chunk, &cx, &cy);
+        ASSERT_M(ret == 2);
+        rg_map_chunk* c = map_chunk_build(m, cx, cy);
+        char* ptr = strchr(line, ']') + 1;
+        for (int p = 0; p < MAP_PLANE_LEN; p++)
+            for (int y = 0; y < MAP_CHUNK_SIZE; y++)
+                c->planes[p][y] = strtoull(ptr, &ptr, 16);
+        line = next_line(line);
+        for (int j = 0; j < MAP_CHUNK_SIZE * MAP_CHUNK_SIZE; j++)
+            c->types[j] = (uint8_t)hex_digit(line[j]);
+        line = next_line(line);
+    }
+    return line;
+}
+
+static void rng_save(rg_rng_streams* rng, FILE* fp)
+{
+    fprintf(fp, fmt_rng_seed_out, rng->seed);
+    fprintf(fp, "\n");
+    for (int i = 0; i < RNG_STREAM_LEN; i++)
+    {
+        uint64_t* s = rng->streams[i].s;
+        fprintf(fp, fmt_rng_stream_out, s[0], s[1], s[2], s[3]);
+        fprintf(fp, "\n");
+    }
+}
+
+static char* rng_load(rg_rng_streams* rng, char* buf)
+{
+    int ret = sscanf_s(buf, fmt_rng_seed, &rng->seed);
+    ASSERT_M(ret == 1);
+    char* line = next_line(buf);
+    for (int i = 0; i < RNG_STREAM_LEN; i++)
     {
-        int blocked, block_sight, explored;
-        ret = sscanf_s(line, fmt_tile, &blocked, &block_sight, &explored);
-        ASSERT_M(ret == 3);
-        rg_tile* t = &m->tiles.data[i];
-        t->blocked = blocked;
-        t->block_sight = block_sight;
-        t->explored = explored;
+        uint64_t* s = rng->streams[i].s;
+        ret = sscanf_s(line, fmt_rng_stream, &s[0], &s[1], &s[2], &s[3]);
+        ASSERT_M(ret == 4);
         line = next_line(line);
     }
     return line;
 }
 
+static void level_cache_save(rg_level_cache* c, FILE* fp)
+{
+    fprintf(fp, fmt_level_cache_len, c->len);
+    fprintf(fp, "\n");
+    for (size_t i = 0; i < c->len; i++)
+    {
+        rg_level_snapshot* s = &c->data[i];
+        fprintf(fp,
+                fmt_cached_level,
+                s->depth,
+                s->width,
+                s->height,
+                s->player.x,
+                s->player.y,
+                s->chunks_len,
+                s->data.len,
+                s->entities_len,
+                s->items.len);
+        fprintf(fp, "\n");
+        map_layout_save(&s->layout, fp);
+        for (size_t k = 0; k < s->chunks_len; k++)
+            fprintf(fp, " %d", s->chunks[k]);
+        fprintf(fp, "\n");
+        // The packed chunks, two hex digits per byte.
+        for (size_t k = 0; k < s->data.len; k++)
+            fprintf(fp, "%02x", s->data.data[k]);
+        fprintf(fp, "\n");
+        for (size_t k = 0; k < s->entities_len; k++)
+        {
+            rg_entity_record* r = &s->entities[k];
+            fprintf(fp,
+                    fmt_cached_entity,
+                    r->x,
+                    r->y,
+                    r->proto,
+                    r->dead,
+                    r->state,
+                    r->confused_prev_state,
+                    r->confused_turns,
+                    r->hp);
+            fprintf(fp, "\n");
+        }
+        for (size_t k = 0; k < s->items.len; k++)
+        {
+            item_save(&s->items.data[k], fp);
+            fprintf(fp, "\n");
+        }
+    }
+}
+
+static char* level_cache_load(rg_level_cache* c, char* buf)
+{
+    size_t len = 0;
+    int ret = sscanf_s(buf, fmt_level_cache_len, &len);
+    ASSERT_M(ret == 1);
+    char* line = next_line(buf);
+    for (size_t i = 0; i < len; i++)
+    {
+        rg_level_snapshot s;
+        memset(&s, 0, sizeof(s));
+        size_t data_len;
+        ret = sscanf_s(line,
+                       fmt_cached_level,
+                       &s.depth,
+                       &s.width,
+                       &s.height,
+                       &s.player.x,
+                       &s.player.y,
+                       &s.chunks_len,
+                       &data_len,
+                       &s.entities_len,
+                       &s.items.len);
+        ASSERT_M(ret == 9);
+        line = map_layout_load(&s.layout, next_line(line));
+
+        s.chunks = malloc(sizeof(*s.chunks) * MAX(s.chunks_len, 1));
+        ASSERT_M(s.chunks != NULL);
+        char* ptr = line;
+        for (size_t k = 0; k < s.chunks_len; k++)
+            s.chunks[k] = (int)strtol(ptr, &ptr, 10);
+        line = next_line(line);
+
+        s.data.len = s.data.capacity = data_len;
+        s.data.data = malloc(MAX(data_len, 1));
+        ASSERT_M(s.data.data != NULL);
+        for (size_t k = 0; k < data_len; k++)
+        {
+            const int hi = hex_digit(line[2 * k]);
+            const int lo = hex_digit(line[2 * k + 1]);
+            s.data.data[k] = (uint8_t)(hi << 4 | lo);
+        }
+        line = next_line(line);
+
+        s.entities = malloc(sizeof(*s.entities) * MAX(s.entities_len, 1));
+        ASSERT_M(s.entities != NULL);
+        for (size_t k = 0; k < s.entities_len; k++)
+        {
+            rg_entity_record* r = &s.entities[k];
+            ret = sscanf_s(line,
+                           fmt_cached_entity,
+                           &r->x,
+                           &r->y,
+                           &r->proto,
+                           &r->dead,
+                           &r->state,
+                           &r->confused_prev_state,
+                           &r->confused_turns,
+                           &r->hp);
+            ASSERT_M(ret == 8);
+            ASSERT_M(r->proto < ENTITY_PROTO_LEN);
+            line = next_line(line);
+        }
+
+        s.items.capacity = MAX(s.items.len, 1);
+        s.items.data = malloc(sizeof(*s.items.data) * s.items.capacity);
+        ASSERT_M(s.items.data != NULL);
+        for (size_t k = 0; k < s.items.len; k++)
+            line = item_load(&s.items.data[k], line);
+
+        level_cache_put(c, &s);
+    }
+    return line;
+}
+
 void turn_log_save(rg_turn_logs* logs, FILE* fp)
 {
     fprintf(fp, fmt_turn_log_len, logs->len);
@@ -486,7 +521,7 @@ void savefile_save(rg_game_state_data* data, const char* path)
     fprintf(fp, "\n");
     for (size_t i = 0; i < data->inventory.len; i++)
     {
-        fprintf(fp, fmt_inventory, data->inventory.data[i]);
+        item_save(inventory_get(&data->inventory, i), fp);
         fprintf(fp, "\n");
     }
     game_map_save(&data->game_map, fp);
@@ -501,6 +536,8 @@ void savefile_save(rg_game_state_data* data, const char* path)
             data->player_level.level_up_base,
             data->player_level.level_up_factor);
     fprintf(fp, "\n");
+    rng_save(&data->rng, fp);
+    level_cache_save(&data->level_cache, fp);
     turn_log_save(&data->logs, fp);
     fclose(fp);
 }
@@ -542,6 +579,8 @@ void savefile_load(rg_game_state_data* data, const char* path)
              &data->player_level.level_up_factor);
     ASSERT_M(ret == 4);
     line = next_line(line);
+    line = rng_load(&data->rng, line);
+    line = level_cache_load(&data->level_cache, line);
     line = turn_logs_load(logs, line);
     if (logs->capacity == 0)
     {
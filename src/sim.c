@@ -0,0 +1,119 @@
+#include "sim.h"
+
+#include <string.h>
+
+#include "app.h"
+#include "gameplay_state.h"
+#include "panic.h"
+#include "types.h"
+
+static void sim_publish(rg_sim* sim, bool ended)
+{
+    rg_app* app = sim->app;
+    rg_frame* f = frame_buffer_back(&sim->frames);
+    f->ended = ended;
+    if (!ended) game_state_compose(&app->game_state_data, f);
+    frame_buffer_publish(&sim->frames);
+
+    SDL_Event event = { 0 };
+    event.type = sim->frame_event;
+    SDL_PushEvent(&event);
+}
+
+// Sleeps while there is neither input nor a turn in progress, and composes a
+// frame after anything that changed the screen. Ends once the game leaves
+// the play screen.
+static int sim_run(void* data)
+{
+    rg_sim* sim = data;
+    rg_app* app = sim->app;
+    rg_game_state_data* game = &app->game_state_data;
+    bool dirty = true;
+    while (!SDL_AtomicGet(&sim->stop))
+    {
+        if (app->screen != APP_SCREEN_PLAY)
+        {
+            SDL_AtomicSet(&sim->ended, 1);
+            sim_publish(sim, true);
+            break;
+        }
+        if (dirty) sim_publish(sim, false);
+        dirty = false;
+
+        if (!game_state_is_busy(game)) event_queue_wait(&sim->input);
+        SDL_Event event;
+        while (app->screen == APP_SCREEN_PLAY &&
+               event_queue_pop(&sim->input, &event))
+            dirty |= game_state_handle_event(app, &event, game);
+        if (app->screen == APP_SCREEN_PLAY && game_state_is_busy(game))
+            dirty |= game_state_handle_event(app, NULL, game);
+    }
+    return 0;
+}
+
+void sim_start(rg_sim* sim, rg_app* app)
+{
+    static Uint32 frame_event = (Uint32)-1;
+    if (frame_event == (Uint32)-1)
+    {
+        frame_event = SDL_RegisterEvents(1);
+        if (frame_event == (Uint32)-1) panic("out of user events");
+    }
+
+    memset(sim, 0, sizeof(*sim));
+    sim->app = app;
+    sim->frame_event = frame_event;
+    event_queue_create(&sim->input);
+    frame_buffer_create(&sim->frames);
+    sim->thread = SDL_CreateThread(sim_run, "sim", sim);
+    if (sim->thread == NULL) panic("failed to create the game thread");
+}
+
+void sim_stop(rg_sim* sim)
+{
+    if (sim->thread == NULL) return;
+    SDL_AtomicSet(&sim->stop, 1);
+    event_queue_wake(&sim->input);
+    SDL_WaitThread(sim->thread, NULL);
+    event_queue_destroy(&sim->input);
+    frame_buffer_destroy(&sim->frames);
+    sim->thread = NULL;
+}
+
+bool sim_is_running(const rg_sim* sim)
+{
+    return sim->thread != NULL;
+}
+
+// True once the game left the play screen, it handles no more input.
+bool sim_has_ended(rg_sim* sim)
+{
+    return sim->thread != NULL && SDL_AtomicGet(&sim->ended);
+}
+
+// Stops an ended game and moves the input it did not get to into `pending`,
+// so it can go to the menu instead. Returns the number of events moved.
+int sim_finish(rg_sim* sim, SDL_Event pending[EVENT_QUEUE_LEN])
+{
+    ASSERT_M(sim_has_ended(sim));
+    SDL_WaitThread(sim->thread, NULL);
+    sim->thread = NULL;
+    int len = 0;
+    while (event_queue_pop(&sim->input, &pending[len])) len++;
+    event_queue_destroy(&sim->input);
+    frame_buffer_destroy(&sim->frames);
+    return len;
+}
+
+// Returns false when the game is too far behind and the event was dropped.
+bool sim_post(rg_sim* sim, const SDL_Event* event)
+{
+    return event_queue_push(&sim->input, event);
+}
+
+// The newest frame since the last call, or NULL. It stays valid until the
+// next call.
+rg_frame* sim_take_frame(rg_sim* sim)
+{
+    return frame_buffer_take(&sim->frames);
+}
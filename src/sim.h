@@ -0,0 +1,36 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "event_queue.h"
+#include "frame.h"
+
+struct rg_app;
+
+// Runs the game on its own thread while the main thread keeps rendering and
+// polling the window. Input goes in through a queue, composed frames come
+// out through a triple buffer and a `frame_event` is pushed for each one.
+// The game state belongs to the thread until sim_stop returns.
+typedef struct rg_sim
+{
+    struct rg_app* app;
+    SDL_Thread* thread; // NULL while stopped
+    rg_event_queue input;
+    rg_frame_buffer frames;
+    SDL_atomic_t stop;
+    SDL_atomic_t ended; // the game left the play screen
+    Uint32 frame_event;
+} rg_sim;
+
+void sim_start(rg_sim* sim, struct rg_app* app);
+void sim_stop(rg_sim* sim);
+bool sim_is_running(const rg_sim* sim);
+bool sim_has_ended(rg_sim* sim);
+int sim_finish(rg_sim* sim, SDL_Event pending[EVENT_QUEUE_LEN]);
+bool sim_post(rg_sim* sim, const SDL_Event* event);
+rg_frame* sim_take_frame(rg_sim* sim);
+
+#endif
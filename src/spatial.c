@@ -0,0 +1,210 @@
+#include "spatial.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "fov.h"
+#include "types.h"
+
+static int bucket_index(rg_spatial_grid* g, int x, int y)
+{
+    int bx = x >> SPATIAL_CELL_SHIFT;
+    int by = y >> SPATIAL_CELL_SHIFT;
+    if (bx < 0 || bx >= g->width || by < 0 || by >= g->height) return -1;
+    return bx + by * g->width;
+}
+
+static void bucket_remove(rg_entity_ids* bucket, rg_entity_id id)
+{
+    for (size_t i = 0; i < bucket->len; i++)
+    {
+        if (bucket->data[i] == id)
+        {
+            bucket->data[i] = bucket->data[bucket->len - 1];
+            bucket->len--;
+            return;
+        }
+    }
+}
+
+static void grid_reserve(rg_spatial_grid* g, size_t len)
+{
+    if (len <= g->capacity) return;
+    size_t capacity = g->capacity == 0 ? 16 : g->capacity;
+    while (capacity < len) capacity *= 2;
+    g->entity_bucket = realloc(g->entity_bucket, sizeof(int) * capacity);
+    ASSERT_M(g->entity_bucket != NULL);
+    for (size_t i = g->capacity; i < capacity; i++) g->entity_bucket[i] = -1;
+    g->capacity = capacity;
+}
+
+void entity_ids_create(rg_entity_ids* ids, size_t capacity)
+{
+    ASSERT_M(capacity > 0);
+    ids->len = 0;
+    ids->capacity = capacity;
+    ids->data = malloc(sizeof(*ids->data) * ids->capacity);
+    ASSERT_M(ids->data != NULL);
+}
+
+void entity_ids_destroy(rg_entity_ids* ids)
+{
+    if (ids == NULL) return;
+    free(ids->data);
+    ids->data = NULL;
+    ids->len = ids->capacity = 0;
+}
+
+void spatial_grid_create(rg_spatial_grid* g, int map_width, int map_height)
+{
+    memset(g, 0, sizeof(*g));
+    int cell = 1 << SPATIAL_CELL_SHIFT;
+    g->width = (map_width + cell - 1) >> SPATIAL_CELL_SHIFT;
+    g->height = (map_height + cell - 1) >> SPATIAL_CELL_SHIFT;
+    g->buckets = malloc(sizeof(*g->buckets) * g->width * g->height);
+    ASSERT_M(g->buckets != NULL);
+    for (int i = 0; i < g->width * g->height; i++)
+        entity_ids_create(&g->buckets[i], 4);
+}
+
+void spatial_grid_destroy(rg_spatial_grid* g)
+{
+    if (g == NULL) return;
+    if (g->buckets != NULL)
+    {
+        for (int i = 0; i < g->width * g->height; i++)
+            entity_ids_destroy(&g->buckets[i]);
+        free(g->buckets);
+    }
+    free(g->entity_bucket);
+    memset(g, 0, sizeof(*g));
+}
+
+void spatial_grid_build(rg_spatial_grid* g, rg_entity_array* entities)
+{
+    for (int i = 0; i < g->width * g->height; i++) g->buckets[i].len = 0;
+    grid_reserve(g, entities->len);
+    for (size_t i = 0; i < g->capacity; i++) g->entity_bucket[i] = -1;
+    g->len = entities->len;
+    for (size_t i = 0; i < entities->len; i++)
+    {
+        rg_entity* e = &entities->data[i];
+        int b = bucket_index(g, e->x, e->y);
+        g->entity_bucket[i] = b;
+        if (b != -1) ARRAY_PUSH(&g->buckets[b], (rg_entity_id)i);
+    }
+}
+
+void spatial_grid_update(rg_spatial_grid* g,
+                         rg_entity_array* entities,
+                         rg_entity_id id)
+{
+    ASSERT_M(id < entities->len);
+    if (id >= g->len)
+    {
+        grid_reserve(g, id + 1);
+        g->len = id + 1;
+    }
+    rg_entity* e = &entities->data[id];
+    int b = bucket_index(g, e->x, e->y);
+    int prev = g->entity_bucket[id];
+    if (b == prev) return;
+    if (prev != -1) bucket_remove(&g->buckets[prev], id);
+    if (b != -1) ARRAY_PUSH(&g->buckets[b], id);
+    g->entity_bucket[id] = b;
+}
+
+void spatial_query_radius(rg_spatial_grid* g,
+                          rg_entity_array* entities,
+                          int x,
+                          int y,
+                          int radius,
+                          rg_entity_ids* out)
+{
+    out->len = 0;
+    const int radius_sq = radius * radius;
+    const int bx0 = MAX(0, (x - radius) >> SPATIAL_CELL_SHIFT);
+    const int by0 = MAX(0, (y - radius) >> SPATIAL_CELL_SHIFT);
+    const int bx1 = MIN(g->width - 1, (x + radius) >> SPATIAL_CELL_SHIFT);
+    const int by1 = MIN(g->height - 1, (y + radius) >> SPATIAL_CELL_SHIFT);
+    for (int by = by0; by <= by1; by++)
+    {
+        for (int bx = bx0; bx <= bx1; bx++)
+        {
+            rg_entity_ids* bucket = &g->buckets[bx + by * g->width];
+            for (size_t i = 0; i < bucket->len; i++)
+            {
+                rg_entity_id id = bucket->data[i];
+                if (entity_distance_sq_to(&entities->data[id], x, y) <=
+                    radius_sq)
+                    ARRAY_PUSH(out, id);
+            }
+        }
+    }
+}
+
+bool spatial_query_nearest(rg_spatial_grid* g,
+                           rg_entity_array* entities,
+                           int x,
+                           int y,
+                           int range,
+                           rg_spatial_filter filter,
+                           void* user_data,
+                           rg_entity_id* out)
+{
+    int best_sq = range * range + 1;
+    bool found = false;
+    const int bx0 = MAX(0, (x - range) >> SPATIAL_CELL_SHIFT);
+    const int by0 = MAX(0, (y - range) >> SPATIAL_CELL_SHIFT);
+    const int bx1 = MIN(g->width - 1, (x + range) >> SPATIAL_CELL_SHIFT);
+    const int by1 = MIN(g->height - 1, (y + range) >> SPATIAL_CELL_SHIFT);
+    for (int by = by0; by <= by1; by++)
+    {
+        for (int bx = bx0; bx <= bx1; bx++)
+        {
+            rg_entity_ids* bucket = &g->buckets[bx + by * g->width];
+            for (size_t i = 0; i < bucket->len; i++)
+            {
+                rg_entity_id id = bucket->data[i];
+                const rg_entity* e = &entities->data[id];
+                int d = entity_distance_sq_to(e, x, y);
+                if (d > best_sq) continue;
+                // Ties go to the lowest id so results don't depend on
+                // bucket order.
+                if (d == best_sq && (!found || id > *out)) continue;
+                if (filter != NULL && !filter(e, user_data)) continue;
+                best_sq = d;
+                *out = id;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void spatial_query_line(rg_spatial_grid* g,
+                        rg_entity_array* entities,
+                        int x0,
+                        int y0,
+                        int x1,
+                        int y1,
+                        rg_entity_ids* out)
+{
+    out->len = 0;
+    rg_line_data line;
+    int x, y;
+    line_init(x0, y0, x1, y1, &line);
+    while (!line_step(&x, &y, &line))
+    {
+        int b = bucket_index(g, x, y);
+        if (b == -1) return; // left the map
+        rg_entity_ids* bucket = &g->buckets[b];
+        for (size_t i = 0; i < bucket->len; i++)
+        {
+            rg_entity_id id = bucket->data[i];
+            const rg_entity* e = &entities->data[id];
+            if (e->x == x && e->y == y) ARRAY_PUSH(out, id);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "entity.h"
+
+// Each bucket covers (1 << SPATIAL_CELL_SHIFT) tiles along both axes.
+#define SPATIAL_CELL_SHIFT 3
+
+typedef struct rg_entity_ids
+{
+    size_t len;
+    size_t capacity;
+    rg_entity_id* data;
+} rg_entity_ids;
+
+typedef struct rg_spatial_grid
+{
+    int width;  // in buckets
+    int height; // in buckets
+    rg_entity_ids* buckets;
+    size_t len;
+    size_t capacity;
+    int* entity_bucket; // bucket each entity is filed under, -1 if none
+} rg_spatial_grid;
+
+typedef bool (*rg_spatial_filter)(const rg_entity* e, void* user_data);
+
+void entity_ids_create(rg_entity_ids* ids, size_t capacity);
+void entity_ids_destroy(rg_entity_ids* ids);
+
+void spatial_grid_create(rg_spatial_grid* g, int map_width, int map_height);
+void spatial_grid_destroy(rg_spatial_grid* g);
+void spatial_grid_build(rg_spatial_grid* g, rg_entity_array* entities);
+void spatial_grid_update(rg_spatial_grid* g,
+                         rg_entity_array* entities,
+                         rg_entity_id id);
+
+void spatial_query_radius(rg_spatial_grid* g,
+                          rg_entity_array* entities,
+                          int x,
+                          int y,
+                          int radius,
+                          rg_entity_ids* out);
+bool spatial_query_nearest(rg_spatial_grid* g,
+                           rg_entity_array* entities,
+                           int x,
+                           int y,
+                           int range,
+                           rg_spatial_filter filter,
+                           void* user_data,
+                           rg_entity_id* out);
+void spatial_query_line(rg_spatial_grid* g,
+                        rg_entity_array* entities,
+                        int x0,
+                        int y0,
+                        int x1,
+                        int y1,
+                        rg_entity_ids* out);
+
+#endif
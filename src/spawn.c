@@ -0,0 +1,178 @@
+#include "spawn.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "entity.h"
+#include "items.h"
+#include "types.h"
+
+#define SPAWN_CURVE_MAX 4
+
+// A value that steps up with the dungeon level. Steps are sorted by level,
+// levels below the first step get 0.
+typedef struct rg_spawn_curve
+{
+    int len;
+    struct
+    {
+        int level;
+        int value;
+    } steps[SPAWN_CURVE_MAX];
+} rg_spawn_curve;
+
+typedef struct rg_spawn_entry
+{
+    int id;
+    rg_spawn_curve weight;
+} rg_spawn_entry;
+
+static const rg_spawn_curve monsters_per_room = {
+    3, { { 1, 2 }, { 4, 3 }, { 6, 5 } }
+};
+
+static const rg_spawn_curve items_per_room = { 2, { { 1, 1 }, { 4, 2 } } };
+
+static const rg_spawn_entry monster_table[] = {
+    { ENTITY_PROTO_ORC, { 1, { { 1, 80 } } } },
+    { ENTITY_PROTO_TROLL, { 3, { { 3, 15 }, { 5, 30 }, { 7, 60 } } } },
+};
+
+static const rg_spawn_entry item_table[] = {
+    { ITEM_PROTO_HEALING_POTION, { 1, { { 1, 35 } } } },
+    { ITEM_PROTO_LIGHTNING_SCROLL, { 1, { { 4, 25 } } } },
+    { ITEM_PROTO_FIREBALL_SCROLL, { 1, { { 6, 25 } } } },
+    { ITEM_PROTO_CONFUSION_SCROLL, { 1, { { 2, 10 } } } },
+    { ITEM_PROTO_FOG_SCROLL, { 1, { { 2, 10 } } } },
+    { ITEM_PROTO_FLOOD_SCROLL, { 1, { { 3, 10 } } } },
+    { ITEM_PROTO_SWORD, { 1, { { 4, 5 } } } },
+    { ITEM_PROTO_SHIELD, { 1, { { 8, 15 } } } },
+};
+
+#define TABLE_LEN(t) ((int)(sizeof(t) / sizeof((t)[0])))
+
+static int curve_value(const rg_spawn_curve* c, int level)
+{
+    ASSERT_M(c->len <= SPAWN_CURVE_MAX);
+    for (int i = c->len - 1; i >= 0; i--)
+    {
+        if (level >= c->steps[i].level) return c->steps[i].value;
+    }
+    return 0;
+}
+
+void alias_sampler_create(rg_alias_sampler* s,
+                          int len,
+                          const int* ids,
+                          const int* weights)
+{
+    memset(s, 0, sizeof(*s));
+    // Entries that can't be drawn are left out entirely.
+    for (int i = 0; i < len; i++)
+    {
+        ASSERT_M(weights[i] >= 0);
+        if (weights[i] > 0)
+        {
+            s->len++;
+            s->total += weights[i];
+        }
+    }
+    if (s->len == 0) return;
+
+    s->ids = malloc(sizeof(*s->ids) * s->len);
+    s->threshold = malloc(sizeof(*s->threshold) * s->len);
+    s->alias = malloc(sizeof(*s->alias) * s->len);
+    int* work = malloc(sizeof(*work) * s->len);
+    ASSERT_M(s->ids != NULL && s->threshold != NULL && s->alias != NULL);
+    ASSERT_M(work != NULL);
+
+    // Scale every weight by len so the average column holds exactly total.
+    // Columns under total go on the small stack (from the front of work),
+    // the others on the large stack (from the back).
+    int small = 0;
+    int large = s->len;
+    for (int i = 0, c = 0; i < len; i++)
+    {
+        if (weights[i] == 0) continue;
+        s->ids[c] = ids[i];
+        s->threshold[c] = weights[i] * s->len;
+        s->alias[c] = c;
+        if (s->threshold[c] < s->total)
+            work[small++] = c;
+        else
+            work[--large] = c;
+        c++;
+    }
+
+    // Fill every small column up to total with the excess of a large one.
+    while (small > 0 && large < s->len)
+    {
+        int under = work[small - 1];
+        int over = work[large];
+        small--;
+        s->alias[under] = over;
+        s->threshold[over] -= s->total - s->threshold[under];
+        if (s->threshold[over] < s->total)
+        {
+            large++;
+            work[small++] = over;
+        }
+    }
+    // Whatever is left holds exactly total.
+    for (int i = 0; i < small; i++) s->threshold[work[i]] = s->total;
+    for (int i = large; i < s->len; i++) s->threshold[work[i]] = s->total;
+    free(work);
+}
+
+void alias_sampler_destroy(rg_alias_sampler* s)
+{
+    if (s == NULL) return;
+    free(s->ids);
+    free(s->threshold);
+    free(s->alias);
+    memset(s, 0, sizeof(*s));
+}
+
+int alias_sampler_draw(const rg_alias_sampler* s, rg_rng* rng)
+{
+    if (s->len == 0) return -1;
+    int col = rng_int(rng, 0, s->len - 1);
+    int r = rng_int(rng, 0, s->total - 1);
+    return r < s->threshold[col] ? s->ids[col] : s->ids[s->alias[col]];
+}
+
+static void sampler_compile(rg_alias_sampler* s,
+                            const rg_spawn_entry* table,
+                            int len,
+                            int level)
+{
+    int* ids = malloc(sizeof(*ids) * len);
+    int* weights = malloc(sizeof(*weights) * len);
+    ASSERT_M(ids != NULL && weights != NULL);
+    for (int i = 0; i < len; i++)
+    {
+        ids[i] = table[i].id;
+        weights[i] = curve_value(&table[i].weight, level);
+    }
+    alias_sampler_create(s, len, ids, weights);
+    free(ids);
+    free(weights);
+}
+
+void spawn_tables_compile(rg_spawn_tables* t, int level)
+{
+    memset(t, 0, sizeof(*t));
+    t->level = level;
+    t->monsters_per_room = curve_value(&monsters_per_room, level);
+    t->items_per_room = curve_value(&items_per_room, level);
+    sampler_compile(
+      &t->monsters, monster_table, TABLE_LEN(monster_table), level);
+    sampler_compile(&t->items, item_table, TABLE_LEN(item_table), level);
+}
+
+void spawn_tables_destroy(rg_spawn_tables* t)
+{
+    if (t == NULL) return;
+    alias_sampler_destroy(&t->monsters);
+    alias_sampler_destroy(&t->items);
+}
@@ -0,0 +1,38 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "rng.h"
+
+// Weighted sampler using Walker's alias method. Every draw picks a column
+// uniformly and then either the column's own id or its alias, so sampling
+// costs the same no matter how many entries the table has.
+typedef struct rg_alias_sampler
+{
+    int len;
+    int total;      // sum of all weights
+    int* ids;
+    int* threshold; // draws in [0, total) below this keep the column's id
+    int* alias;
+} rg_alias_sampler;
+
+// Per dungeon level spawn data, compiled from the static tables in spawn.c.
+typedef struct rg_spawn_tables
+{
+    int level;
+    int monsters_per_room;
+    int items_per_room;
+    rg_alias_sampler monsters; // yields rg_entity_proto_id
+    rg_alias_sampler items;    // yields rg_item_proto_id
+} rg_spawn_tables;
+
+void alias_sampler_create(rg_alias_sampler* s,
+                          int len,
+                          const int* ids,
+                          const int* weights);
+void alias_sampler_destroy(rg_alias_sampler* s);
+int alias_sampler_draw(const rg_alias_sampler* s, rg_rng* rng);
+
+void spawn_tables_compile(rg_spawn_tables* t, int level);
+void spawn_tables_destroy(rg_spawn_tables* t);
+
+#endif
@@ -15,7 +15,7 @@ void terminal_create(rg_terminal* t,
                      const char* title,
                      bool vsync)
 {
-    memset(t, 0, sizeof(t));
+    memset(t, 0, sizeof(*t));
     t->width = w;
     t->height = h;
     t->app = app;
@@ -27,7 +27,7 @@ void terminal_create(rg_terminal* t,
     SDL_SetWindowPosition(
       t->app->window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     SDL_SetWindowTitle(t->app->window, title);
-    SDL_ShowWindow(t->app->window);
+    if (!t->app->headless) SDL_ShowWindow(t->app->window);
     SDL_RenderSetLogicalSize(t->app->renderer,
                              t->width * t->tileset->tile_size,
                              t->height * t->tileset->tile_size);
@@ -1,6 +1,8 @@
 #include "tileset.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <SDL_image.h>
@@ -42,6 +44,86 @@ int tcod_tileset_chars[TILESET_CHARS_TOTAL] = {
     0x00,   0x00,   0x00,   0x00,
 };
 
+static uint32_t glyph_hash(int ch)
+{
+    return ((uint32_t)ch * 2654435761u) >> (32 - TILESET_WIDE_SHIFT);
+}
+
+static void wide_insert(rg_tileset* ts, int ch, int index)
+{
+    uint32_t slot = glyph_hash(ch);
+    while (ts->wide[slot].ch != -1 && ts->wide[slot].ch != ch)
+        slot = (slot + 1) & (TILESET_WIDE_SLOTS - 1);
+    if (ts->wide[slot].ch == -1) ts->wide_len++;
+    ts->wide[slot].ch = ch;
+    ts->wide[slot].index = (int16_t)index;
+}
+
+// Shifts the entries after the removed one back so no probe sequence is
+// broken by the hole.
+static void wide_remove(rg_tileset* ts, int ch)
+{
+    const uint32_t mask = TILESET_WIDE_SLOTS - 1;
+    uint32_t slot = glyph_hash(ch);
+    while (ts->wide[slot].ch != ch)
+    {
+        if (ts->wide[slot].ch == -1) return;
+        slot = (slot + 1) & mask;
+    }
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & mask; ts->wide[next].ch != -1;
+         next = (next + 1) & mask)
+    {
+        // Entries whose home is cyclically in (hole, next] stay put.
+        const uint32_t home = glyph_hash(ts->wide[next].ch);
+        if (((next - home) & mask) < ((next - hole) & mask)) continue;
+        ts->wide[hole] = ts->wide[next];
+        hole = next;
+    }
+    ts->wide[hole].ch = -1;
+    ts->wide_len--;
+}
+
+// Fills the lookup tables from char_indices, the first glyph of a codepoint
+// wins as it did with the linear scan.
+static void tileset_build_lookup(rg_tileset* ts)
+{
+    for (int i = 0; i < TILESET_LATIN_LEN; i++) ts->latin[i] = -1;
+    for (int i = 0; i < TILESET_WIDE_SLOTS; i++) ts->wide[i].ch = -1;
+    ts->wide_len = 0;
+    for (int i = TILESET_CHARS_TOTAL - 1; i >= 0; i--)
+    {
+        const int ch = ts->char_indices[i];
+        if (ch >= 0 && ch < TILESET_LATIN_LEN)
+            ts->latin[ch] = (int16_t)i;
+        else
+            wide_insert(ts, ch, i);
+    }
+    ts->glyphs_len = TILESET_CHARS_TOTAL;
+    ts->frame = 1;
+}
+
+// Lays out one tile per glyph, row by row.
+static void tileset_build_srcs(rg_tileset* ts)
+{
+    int x = 0, y = 0;
+    for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
+    {
+        if (x + ts->tile_size > ts->tiles_wide * ts->tile_size)
+        {
+            x = 0;
+            y += ts->tile_size;
+            assert(y + ts->tile_size <= ts->tiles_high * ts->tile_size);
+        }
+        SDL_Rect* r = &ts->srcs[i];
+        r->x = x;
+        r->y = y;
+        r->w = ts->tile_size;
+        r->h = ts->tile_size;
+        x += ts->tile_size;
+    }
+}
+
 void tileset_create(rg_tileset* ts,
                     SDL_Renderer* renderer,
                     const char* file,
@@ -60,46 +142,178 @@ void tileset_create(rg_tileset* ts,
     }
     int w, h;
     SDL_QueryTexture(ts->texture, NULL, NULL, &w, &h);
+    ts->texture_width = w;
+    ts->texture_height = h;
     ts->tile_size = w / tiles_wide;
     ts->tiles_wide = tiles_wide;
     ts->tiles_high = tiles_high;
 
-    memcpy(ts->char_indices, tcod_tileset_chars, sizeof(ts->char_indices));
+    memcpy(ts->char_indices, tcod_tileset_chars, sizeof(tcod_tileset_chars));
+    tileset_build_lookup(ts);
 
-    // SRC Rects
+    tileset_build_srcs(ts);
+}
+
+// Atlases rasterized from a font are cached next to it, keyed by everything
+// that changes the pixels. The file holds the header followed by the texture
+// rows, ready for upload.
+#define ATLAS_MAGIC 0x54415247u // "RGAT"
+#define ATLAS_VERSION 1u
+#define ATLAS_DPI 96
+#define ATLAS_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+typedef struct rg_atlas_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ttf_version;
+    uint32_t path_hash;
+    uint64_t font_hash;
+    int32_t ptsize;
+    int32_t dpi;
+    int32_t tile_size;
+    int32_t tiles_wide;
+    int32_t tiles_high;
+    int32_t width;
+    int32_t height;
+    int32_t char_indices[TILESET_CHARS_TOTAL];
+    SDL_Rect srcs[TILESET_CHARS_TOTAL];
+} rg_atlas_header;
+
+// FNV-1a
+static uint64_t atlas_hash(const uint8_t* data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++)
     {
-        int x = 0, y = 0;
-        for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
-        {
-            if (x + ts->tile_size > ts->tiles_wide * ts->tile_size)
-            {
-                x = 0;
-                y += ts->tile_size;
-                assert(y + ts->tile_size <= ts->tiles_high * ts->tile_size);
-            }
-            SDL_Rect* r = &ts->srcs[i];
-            r->x = x;
-            r->y = y;
-            r->w = ts->tile_size;
-            r->h = ts->tile_size;
-            x += ts->tile_size;
-        }
+        h ^= data[i];
+        h *= 0x100000001b3ull;
     }
+    return h;
 }
 
-void tileset_create_from_ttf(rg_tileset* ts,
-                             SDL_Renderer* renderer,
-                             const char* file,
-                             int ptsize,
-                             int tiles_wide,
-                             int tiles_high)
+static uint8_t* read_file(const char* file, size_t* len)
 {
-    memset(ts, 0, sizeof(rg_tileset));
-    TTF_Init();
+    FILE* fp = fopen(file, "rb");
+    if (fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long sz = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* buf = sz > 0 ? malloc(sz) : NULL;
+    if (buf != NULL && fread(buf, 1, sz, fp) != (size_t)sz)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    *len = (size_t)sz;
+    return buf;
+}
 
-    TTF_Font* fnt = TTF_OpenFontDPI(file, ptsize, 96, 96);
-    ASSERT_M(fnt != NULL);
+static void atlas_upload(rg_tileset* ts,
+                         SDL_Renderer* renderer,
+                         const void* pixels,
+                         int pitch)
+{
+    ts->texture = SDL_CreateTexture(renderer,
+                                    ATLAS_FORMAT,
+                                    SDL_TEXTUREACCESS_STATIC,
+                                    ts->texture_width,
+                                    ts->texture_height);
+    ASSERT_M(ts->texture != NULL);
+    SDL_UpdateTexture(ts->texture, NULL, pixels, pitch);
+    SDL_SetTextureBlendMode(ts->texture, SDL_BLENDMODE_BLEND);
+}
+
+// Sets up the tileset from a cached atlas, returns false if there is none or
+// it was made from something else.
+// Checks the layout of a cache that matched its key, so a corrupt file is
+// rasterized again instead of uploaded.
+static bool atlas_header_is_valid(const rg_atlas_header* h, size_t len)
+{
+    if (h->tile_size <= 0 || h->tiles_wide <= 0 || h->tiles_high <= 0 ||
+        (int64_t)h->tile_size * h->tiles_wide != h->width ||
+        (int64_t)h->tile_size * h->tiles_high != h->height ||
+        len - sizeof(*h) != (size_t)h->width * h->height * 4)
+        return false;
+    for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
+    {
+        const SDL_Rect* r = &h->srcs[i];
+        if (r->x < 0 || r->y < 0 || r->w != h->tile_size ||
+            r->h != h->tile_size || r->x > h->width - r->w ||
+            r->y > h->height - r->h)
+            return false;
+    }
+    return true;
+}
+
+static bool atlas_load(rg_tileset* ts,
+                       SDL_Renderer* renderer,
+                       const char* cache_file,
+                       const rg_atlas_header* key)
+{
+    size_t len;
+    uint8_t* buf = read_file(cache_file, &len);
+    if (buf == NULL) return false;
+    const rg_atlas_header* h = (const rg_atlas_header*)buf;
+    const bool ok =
+      len >= sizeof(*h) && h->magic == key->magic &&
+      h->version == key->version && h->ttf_version == key->ttf_version &&
+      h->path_hash == key->path_hash && h->font_hash == key->font_hash &&
+      h->ptsize == key->ptsize && h->dpi == key->dpi &&
+      atlas_header_is_valid(h, len);
+    if (ok)
+    {
+        ts->tile_size = h->tile_size;
+        ts->tiles_wide = h->tiles_wide;
+        ts->tiles_high = h->tiles_high;
+        ts->texture_width = h->width;
+        ts->texture_height = h->height;
+        memcpy(ts->char_indices, h->char_indices, sizeof(h->char_indices));
+        memcpy(ts->srcs, h->srcs, sizeof(h->srcs));
+        atlas_upload(ts, renderer, buf + sizeof(*h), h->width * 4);
+        ts->atlas = SDL_CreateRGBSurfaceWithFormat(
+          0, h->width, h->height, 32, ATLAS_FORMAT);
+        ASSERT_M(ts->atlas != NULL && ts->atlas->pitch == h->width * 4);
+        memcpy(ts->atlas->pixels, buf + sizeof(*h), len - sizeof(*h));
+    }
+    free(buf);
+    return ok;
+}
+
+static void atlas_save(const rg_tileset* ts,
+                       const char* cache_file,
+                       const rg_atlas_header* key,
+                       const SDL_Surface* s)
+{
+    rg_atlas_header h = *key;
+    h.tile_size = ts->tile_size;
+    h.tiles_wide = ts->tiles_wide;
+    h.tiles_high = ts->tiles_high;
+    h.width = s->w;
+    h.height = s->h;
+    memcpy(h.char_indices, ts->char_indices, sizeof(h.char_indices));
+    memcpy(h.srcs, ts->srcs, sizeof(h.srcs));
 
+    // A missing cache is only slower, failing to write one is not an error.
+    FILE* fp = fopen(cache_file, "wb");
+    if (fp == NULL) return;
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (int y = 0; ok && y < s->h; y++)
+    {
+        const uint8_t* row = (const uint8_t*)s->pixels + y * s->pitch;
+        ok = fwrite(row, 4, s->w, fp) == (size_t)s->w;
+    }
+    fclose(fp);
+    if (!ok) remove(cache_file);
+}
+
+// Renders every glyph of the font into one surface, black is transparent.
+static SDL_Surface* atlas_rasterize(rg_tileset* ts,
+                                    TTF_Font* fnt,
+                                    int tiles_wide,
+                                    int tiles_high)
+{
     SDL_Surface* tmp = TTF_RenderGlyph32_LCD(fnt, 'M', WHITE, BLACK);
     ASSERT_M(tmp != NULL);
 
@@ -111,15 +325,8 @@ void tileset_create_from_ttf(rg_tileset* ts,
     SDL_Surface* main_surface = SDL_CreateRGBSurfaceWithFormat(
       0, texture_width, texture_height, 32, tmp->format->format);
     ASSERT_M(main_surface != NULL);
-    /*ts->texture = SDL_CreateTexture(renderer,
-                                    SDL_PIXELFORMAT_RGBA32,
-                                    SDL_TEXTUREACCESS_TARGET,
-                                    texture_width,
-                                    texture_height);*/
     SDL_FreeSurface(tmp);
 
-    //SDL_SetRenderTarget(renderer, ts->texture);
-    
     int x = 0, y = 0;
     for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
     {
@@ -135,57 +342,233 @@ void tileset_create_from_ttf(rg_tileset* ts,
             x = 0;
             y += ts->tile_size;
         }
-        //SDL_Texture* t = SDL_CreateTextureFromSurface(renderer, s);
         SDL_Rect dest;
         dest.x = x + (ts->tile_size / 2 - s->w / 2);
         dest.y = y;
         dest.w = s->w;
         dest.h = s->h;
-        if (ts->tile_size == -1) ts->tile_size = s->h;
-        //SDL_RenderCopy(renderer, t, NULL, &dest);
         SDL_BlitSurface(s, NULL, main_surface, &dest);
-        /*
-        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-        SDL_Rect bound = { x, y, s->h, s->h };
-        SDL_RenderDrawRect(renderer, &bound);*/
-
         SDL_FreeSurface(s);
-        //SDL_DestroyTexture(t);
         x += ts->tile_size;
     }
     SDL_SetColorKey(
       main_surface, SDL_TRUE, SDL_MapRGB(main_surface->format, 0, 0, 0));
-    ts->texture = SDL_CreateTextureFromSurface(renderer, main_surface);
-    ASSERT_M(ts->texture != NULL);
-    //SDL_SetRenderTarget(renderer, NULL);
-    TTF_CloseFont(fnt);
-    TTF_Quit();
+    // Converting turns the color key into alpha, the pixels can then be
+    // uploaded and cached as they are.
+    SDL_Surface* atlas =
+      SDL_ConvertSurfaceFormat(main_surface, ATLAS_FORMAT, 0);
+    ASSERT_M(atlas != NULL);
+    SDL_FreeSurface(main_surface);
+    ts->texture_width = texture_width;
+    ts->texture_height = texture_height;
+    return atlas;
+}
+
+// Starts a new frame for the eviction order, glyphs printed in the current
+// frame are never evicted.
+void tileset_next_frame(rg_tileset* ts)
+{
+    ts->frame++;
+}
 
-    memcpy(ts->char_indices, tcod_tileset_chars, sizeof(ts->char_indices));
+static SDL_Rect glyph_rect(const rg_tileset* ts, int i)
+{
+    const SDL_Rect r = { .x = (i % ts->tiles_wide) * ts->tile_size,
+                         .y = (i / ts->tiles_wide) * ts->tile_size,
+                         .w = ts->tile_size,
+                         .h = ts->tile_size };
+    return r;
+}
+
+// Doubles the rows of the atlas, returns false once it is at its largest.
+static bool atlas_grow(rg_tileset* ts)
+{
+    if (ts->glyphs_capacity >= TILESET_MAX_GLYPHS) return false;
+    const int capacity = MIN(ts->glyphs_capacity * 2, TILESET_MAX_GLYPHS);
+    const int rows = (capacity + ts->tiles_wide - 1) / ts->tiles_wide;
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(
+      0, ts->atlas->w, rows * ts->tile_size, 32, ts->atlas->format->format);
+    if (atlas == NULL) return false;
+    SDL_SetSurfaceBlendMode(ts->atlas, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(ts->atlas, NULL, atlas, NULL);
+    SDL_FreeSurface(ts->atlas);
+    ts->atlas = atlas;
 
-    // SRC Rects
+    SDL_DestroyTexture(ts->texture);
+    ts->texture_height = atlas->h;
+    atlas_upload(ts, ts->renderer, atlas->pixels, atlas->pitch);
+    ts->glyphs_capacity = capacity;
+    return true;
+}
+
+// Least recently printed glyph not printed this frame, -1 if there is none.
+static int glyph_victim(const rg_tileset* ts)
+{
+    int victim = -1;
+    for (int i = TILESET_CHARS_TOTAL; i < ts->glyphs_len; i++)
+    {
+        if (ts->last_used[i] == ts->frame) continue;
+        if (victim == -1 || ts->last_used[i] < ts->last_used[victim])
+            victim = i;
+    }
+    return victim;
+}
+
+// Rasterizes a glyph into slot `i` of the atlas and the texture, centered
+// like the ones made up front. Glyphs wider than a tile are clipped.
+static bool glyph_rasterize(rg_tileset* ts, int ch, int i)
+{
+    SDL_Surface* s = TTF_RenderGlyph32_LCD(ts->font, ch, WHITE, BLACK);
+    if (s == NULL) return false;
+    SDL_Surface* tile = SDL_CreateRGBSurfaceWithFormat(
+      0, ts->tile_size, ts->tile_size, 32, s->format->format);
+    ASSERT_M(tile != NULL);
+    SDL_Rect dest = { .x = ts->tile_size / 2 - s->w / 2,
+                      .y = 0,
+                      .w = s->w,
+                      .h = s->h };
+    SDL_BlitSurface(s, NULL, tile, &dest);
+    SDL_FreeSurface(s);
+    SDL_SetColorKey(tile, SDL_TRUE, SDL_MapRGB(tile->format, 0, 0, 0));
+    SDL_Surface* glyph =
+      SDL_ConvertSurfaceFormat(tile, ts->atlas->format->format, 0);
+    SDL_FreeSurface(tile);
+    ASSERT_M(glyph != NULL);
+
+    SDL_Rect r = glyph_rect(ts, i);
+    SDL_SetSurfaceBlendMode(glyph, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(glyph, NULL, ts->atlas, &r);
+    SDL_FreeSurface(glyph);
+    r = glyph_rect(ts, i);
+    const uint8_t* pixels = (const uint8_t*)ts->atlas->pixels +
+                            r.y * ts->atlas->pitch + r.x * 4;
+    SDL_UpdateTexture(ts->texture, &r, pixels, ts->atlas->pitch);
+    ts->srcs[i] = r;
+    ts->char_indices[i] = ch;
+    return true;
+}
+
+// Looks up a codepoint that has no up front latin glyph, rasterizing it if
+// the font has it. Misses are remembered while the table has room.
+int tileset_glyph_load(rg_tileset* ts, int ch)
+{
+    uint32_t slot = glyph_hash(ch);
+    while (ts->wide[slot].ch != -1)
     {
-        int x = 0, y = 0;
-        for (int i = 0; i < TILESET_CHARS_TOTAL; i++)
+        if (ts->wide[slot].ch == ch)
         {
-            if (x + ts->tile_size > ts->tiles_wide * ts->tile_size)
-            {
-                x = 0;
-                y += ts->tile_size;
-                assert(y + ts->tile_size <= ts->tiles_high * ts->tile_size);
-            }
-            SDL_Rect* r = &ts->srcs[i];
-            r->x = x;
-            r->y = y;
-            r->w = ts->tile_size;
-            r->h = ts->tile_size;
-            x += ts->tile_size;
+            const int i = ts->wide[slot].index;
+            if (i >= 0) ts->last_used[i] = ts->frame;
+            return i;
+        }
+        slot = (slot + 1) & (TILESET_WIDE_SLOTS - 1);
+    }
+    if (ts->font_file == NULL || ch < 0) return -1;
+
+    if (ts->font == NULL)
+    {
+        TTF_Init();
+        ts->font =
+          TTF_OpenFontDPI(ts->font_file, ts->ptsize, ATLAS_DPI, ATLAS_DPI);
+        if (ts->font == NULL)
+        {
+            TTF_Quit();
+            SDL_free(ts->font_file);
+            ts->font_file = NULL;
+            return -1;
         }
     }
+    const bool can_remember = ts->wide_len < TILESET_WIDE_SLOTS / 2;
+    if (!TTF_GlyphIsProvided32(ts->font, ch))
+    {
+        if (can_remember) wide_insert(ts, ch, -1);
+        return -1;
+    }
+
+    int i;
+    if (ts->glyphs_len < ts->glyphs_capacity || atlas_grow(ts))
+    {
+        i = ts->glyphs_len;
+    }
+    else
+    {
+        i = glyph_victim(ts);
+        if (i == -1) return -1;
+        wide_remove(ts, ts->char_indices[i]);
+        ts->evictions++;
+    }
+    if (!can_remember && i == ts->glyphs_len) return -1;
+    if (!glyph_rasterize(ts, ch, i)) return -1;
+    if (i == ts->glyphs_len) ts->glyphs_len++;
+    wide_insert(ts, ch, i);
+    ts->last_used[i] = ts->frame;
+    return i;
+}
+
+void tileset_create_from_ttf(rg_tileset* ts,
+                             SDL_Renderer* renderer,
+                             const char* file,
+                             int ptsize,
+                             int tiles_wide,
+                             int tiles_high)
+{
+    memset(ts, 0, sizeof(rg_tileset));
+
+    size_t font_len;
+    uint8_t* font = read_file(file, &font_len);
+    ASSERT_M(font != NULL);
+
+    const SDL_version* ttf = TTF_Linked_Version();
+    rg_atlas_header key = { 0 };
+    key.magic = ATLAS_MAGIC;
+    key.version = ATLAS_VERSION;
+    key.ttf_version = SDL_VERSIONNUM(ttf->major, ttf->minor, ttf->patch);
+    key.path_hash = (uint32_t)atlas_hash((const uint8_t*)file, strlen(file));
+    key.font_hash = atlas_hash(font, font_len);
+    key.ptsize = ptsize;
+    key.dpi = ATLAS_DPI;
+
+    char cache_file[512];
+    snprintf(cache_file, sizeof(cache_file), "%s.%d.atlas", file, ptsize);
+    ts->renderer = renderer;
+    ts->font_file = SDL_strdup(file);
+    ts->ptsize = ptsize;
+    if (atlas_load(ts, renderer, cache_file, &key))
+    {
+        free(font);
+        tileset_build_lookup(ts);
+        ts->glyphs_capacity = ts->tiles_wide * ts->tiles_high;
+        return;
+    }
+
+    TTF_Init();
+    SDL_RWops* rw = SDL_RWFromConstMem(font, (int)font_len);
+    TTF_Font* fnt = TTF_OpenFontDPIRW(rw, 1, ptsize, ATLAS_DPI, ATLAS_DPI);
+    ASSERT_M(fnt != NULL);
+    SDL_Surface* atlas = atlas_rasterize(ts, fnt, tiles_wide, tiles_high);
+    TTF_CloseFont(fnt);
+    TTF_Quit();
+    free(font);
+
+    memcpy(ts->char_indices, tcod_tileset_chars, sizeof(tcod_tileset_chars));
+    tileset_build_lookup(ts);
+    tileset_build_srcs(ts);
+    ts->glyphs_capacity = ts->tiles_wide * ts->tiles_high;
+
+    atlas_upload(ts, renderer, atlas->pixels, atlas->pitch);
+    atlas_save(ts, cache_file, &key, atlas);
+    ts->atlas = atlas;
 }
 
 void tileset_destroy(rg_tileset* ts)
 {
     if (ts == NULL) return;
     if (ts->texture != NULL) SDL_DestroyTexture(ts->texture);
+    if (ts->font != NULL)
+    {
+        TTF_CloseFont(ts->font);
+        TTF_Quit();
+    }
+    SDL_FreeSurface(ts->atlas);
+    SDL_free(ts->font_file);
 }
\ No newline at end of file
@@ -3,16 +3,50 @@
 
 #include <SDL.h>
 
+#include <stdint.h>
+
+// Glyphs rasterized up front, they are never evicted.
 #define TILESET_CHARS_TOTAL 256
+// Other codepoints are rasterized on first use, the atlas grows up to this
+// many glyphs and then reuses the least recently used slot.
+#define TILESET_MAX_GLYPHS 1024
+// Codepoints below this are looked up directly, the rest are hashed.
+#define TILESET_LATIN_LEN 256
+// Power of two, at most half full keeps the probe sequences short.
+#define TILESET_WIDE_SHIFT 12
+#define TILESET_WIDE_SLOTS (1 << TILESET_WIDE_SHIFT)
+
+typedef struct rg_glyph_slot
+{
+    int32_t ch;    // -1 when empty
+    int16_t index; // -1 if the font has no glyph for it
+} rg_glyph_slot;
 
 typedef struct rg_tileset
 {
     int tile_size;
     int tiles_wide;
     int tiles_high;
-    int char_indices[TILESET_CHARS_TOTAL];
-    SDL_Rect srcs[TILESET_CHARS_TOTAL];
+    int char_indices[TILESET_MAX_GLYPHS]; // codepoint per glyph
+    SDL_Rect srcs[TILESET_MAX_GLYPHS];
     SDL_Texture *texture;
+    int texture_width;
+    int texture_height;
+    int16_t latin[TILESET_LATIN_LEN]; // up front glyph per codepoint or -1
+    rg_glyph_slot wide[TILESET_WIDE_SLOTS];
+    int wide_len;
+
+    // Glyphs loaded on demand, only for tilesets made from a font.
+    SDL_Renderer *renderer;
+    char *font_file;
+    int ptsize;
+    struct _TTF_Font *font; // opened on the first missing glyph
+    SDL_Surface *atlas;     // copy of the texture for growing it
+    int glyphs_len;
+    int glyphs_capacity;    // slots the texture has room for
+    uint32_t frame;
+    uint32_t last_used[TILESET_MAX_GLYPHS]; // frame a glyph was last printed
+    uint32_t evictions;     // bumped when a slot gets another glyph
 } rg_tileset;
 
 void tileset_create(rg_tileset *ts,
@@ -27,5 +61,17 @@ void tileset_create_from_ttf(rg_tileset *ts,
                              int tiles_wide,
                              int tiles_high);
 void tileset_destroy(rg_tileset *ts);
+void tileset_next_frame(rg_tileset *ts);
+
+int tileset_glyph_load(rg_tileset *ts, int ch);
+
+// Index of the glyph drawn for a codepoint, -1 if the tileset has none. Glyphs
+// the font has but the atlas doesn't yet are rasterized into it.
+static inline int tileset_glyph(rg_tileset *ts, int ch)
+{
+    if (ch >= 0 && ch < TILESET_LATIN_LEN && ts->latin[ch] != -1)
+        return ts->latin[ch];
+    return tileset_glyph_load(ts, ch);
+}
 
 #endif // TILESET_H
\ No newline at end of file
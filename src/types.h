@@ -14,7 +14,6 @@
 
 #define MIN(x, y) (x < y ? x : y)
 #define MAX(x, y) (x > y ? x : y)
-#define RAND_INT(min, max) (min + rand() / (RAND_MAX / (max - min + 1) + 1))
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -36,7 +35,4 @@
 #endif
 
 
-int rand_int_choice_index(int len, int* data);
-
-
 #endif
\ No newline at end of file